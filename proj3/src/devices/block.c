@@ -4,6 +4,11 @@
 #include <stdio.h>
 #include "devices/ide.h"
 #include "threads/malloc.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#ifdef USERPROG
+#include "userprog/pagedir.h"
+#endif
 
 /* A block device. */
 struct block
@@ -21,6 +26,9 @@ struct block
     unsigned long long write_cnt;       /* Number of sectors written. */
   };
 
+/* Most requests that transfer() keeps in flight at once. */
+#define TRANSFER_BATCH 8
+
 /* List of all block devices. */
 static struct list all_blocks = LIST_INITIALIZER (all_blocks);
 
@@ -28,6 +36,10 @@ static struct list all_blocks = LIST_INITIALIZER (all_blocks);
 static struct block *block_by_role[BLOCK_ROLE_CNT];
 
 static struct block *list_elem_to_block (struct list_elem *);
+static void transfer (struct block *, block_sector_t, void *, size_t cnt,
+                      bool write);
+static void submit_and_wait (struct block *, struct block_request[],
+                             size_t cnt);
 
 /* Returns a human-readable name for the given block device
    TYPE. */
@@ -120,9 +132,7 @@ check_sector (struct block *block, block_sector_t sector)
 void
 block_read (struct block *block, block_sector_t sector, void *buffer)
 {
-  check_sector (block, sector);
-  block->ops->read (block->aux, sector, buffer);
-  block->read_cnt++;
+  transfer (block, sector, buffer, 1, false);
 }
 
 /* Write sector SECTOR to BLOCK from BUFFER, which must contain
@@ -133,10 +143,191 @@ block_read (struct block *block, block_sector_t sector, void *buffer)
 void
 block_write (struct block *block, block_sector_t sector, const void *buffer)
 {
-  check_sector (block, sector);
-  ASSERT (block->type != BLOCK_FOREIGN);
-  block->ops->write (block->aux, sector, buffer);
-  block->write_cnt++;
+  transfer (block, sector, (void *) buffer, 1, true);
+}
+
+/* Reads the CNT sectors starting at SECTOR from BLOCK into
+   BUFFER, which must have room for CNT * BLOCK_SECTOR_SIZE
+   bytes.  Drivers that support it move all the sectors with as
+   few commands as possible.
+   Internally synchronizes accesses to block devices, so external
+   per-block device locking is unneeded. */
+void
+block_read_multiple (struct block *block, block_sector_t sector,
+                     void *buffer, size_t cnt)
+{
+  transfer (block, sector, buffer, cnt, false);
+}
+
+/* Writes the CNT sectors starting at SECTOR to BLOCK from
+   BUFFER, which must contain CNT * BLOCK_SECTOR_SIZE bytes.
+   Returns after the block device has acknowledged receiving the
+   data.  Drivers that support it move all the sectors with as
+   few commands as possible.
+   Internally synchronizes accesses to block devices, so external
+   per-block device locking is unneeded. */
+void
+block_write_multiple (struct block *block, block_sector_t sector,
+                      const void *buffer, size_t cnt)
+{
+  transfer (block, sector, (void *) buffer, cnt, true);
+}
+
+/* Submits requests to move CNT sectors between BLOCK and BUFFER
+   and waits for them to complete.  Drivers cannot reach user
+   memory from the context they run in, so a user BUFFER is moved
+   through the kernel frames that back it, one request per run
+   of physically contiguous frames.  Its pages must be present
+   and pinned, and no sector in it may cross a page boundary. */
+static void
+transfer (struct block *block, block_sector_t sector, void *buffer,
+          size_t cnt, bool write)
+{
+  struct block_request r[TRANSFER_BATCH];
+#ifdef USERPROG
+  size_t r_cnt = 0;
+  uint8_t *p;
+#endif
+
+  if (is_kernel_vaddr (buffer))
+    {
+      block_request_init (&r[0], sector, buffer, cnt, write, NULL, NULL);
+      submit_and_wait (block, r, 1);
+      return;
+    }
+
+#ifdef USERPROG
+  for (p = buffer; cnt > 0; )
+    {
+      uint8_t *frame = pagedir_get_page (thread_current ()->pagedir, p);
+      size_t chunk_cnt = (PGSIZE - pg_ofs (p)) / BLOCK_SECTOR_SIZE;
+      struct block_request *prev = r_cnt > 0 ? &r[r_cnt - 1] : NULL;
+
+      ASSERT (frame != NULL);
+      ASSERT (chunk_cnt > 0);
+      if (chunk_cnt > cnt)
+        chunk_cnt = cnt;
+
+      if (prev != NULL
+          && (uint8_t *) prev->buffer + prev->cnt * BLOCK_SECTOR_SIZE == frame)
+        prev->cnt += chunk_cnt;
+      else
+        {
+          if (r_cnt == TRANSFER_BATCH)
+            {
+              submit_and_wait (block, r, r_cnt);
+              r_cnt = 0;
+            }
+          block_request_init (&r[r_cnt++], sector, frame, chunk_cnt, write,
+                              NULL, NULL);
+        }
+
+      sector += chunk_cnt;
+      p += chunk_cnt * BLOCK_SECTOR_SIZE;
+      cnt -= chunk_cnt;
+    }
+  submit_and_wait (block, r, r_cnt);
+#else
+  PANIC ("block transfer to user address %p", buffer);
+#endif
+}
+
+/* Submits the CNT requests in R to BLOCK, then waits for all of
+   them to complete. */
+static void
+submit_and_wait (struct block *block, struct block_request r[], size_t cnt)
+{
+  size_t i;
+
+  for (i = 0; i < cnt; i++)
+    block_submit (block, &r[i]);
+  for (i = 0; i < cnt; i++)
+    block_wait (&r[i]);
+}
+
+/* Initializes R as a request to move CNT sectors starting at
+   SECTOR between a block device and BUFFER, writing to the
+   device if WRITE is true and reading from it otherwise.  If
+   CALLBACK is non-null, it will be called with R when the
+   request completes; otherwise, wait for R with block_wait(). */
+void
+block_request_init (struct block_request *r, block_sector_t sector,
+                    void *buffer, size_t cnt, bool write,
+                    void (*callback) (struct block_request *), void *aux)
+{
+  r->sector = sector;
+  r->buffer = buffer;
+  r->cnt = cnt;
+  r->write = write;
+  r->callback = callback;
+  r->aux = aux;
+  sema_init (&r->done, 0);
+}
+
+/* Queues request R on BLOCK and returns, usually before the
+   transfer is done.  R and its buffer must stay valid until R
+   completes.  R's sector may be changed on the way down to the
+   driver, as partitions translate it.
+   May be called from an interrupt handler, such as a completion
+   callback. */
+void
+block_submit (struct block *block, struct block_request *r)
+{
+  size_t i;
+
+  ASSERT (is_kernel_vaddr (r->buffer));
+
+  if (r->cnt == 0)
+    {
+      block_complete (r);
+      return;
+    }
+  check_sector (block, r->sector);
+  check_sector (block, r->sector + r->cnt - 1);
+  if (r->write)
+    {
+      ASSERT (block->type != BLOCK_FOREIGN);
+      block->write_cnt += r->cnt;
+    }
+  else
+    block->read_cnt += r->cnt;
+
+  if (block->ops->submit != NULL)
+    block->ops->submit (block->aux, r);
+  else
+    {
+      /* A synchronous driver finishes the request right here. */
+      for (i = 0; i < r->cnt; i++)
+        {
+          uint8_t *p = (uint8_t *) r->buffer + i * BLOCK_SECTOR_SIZE;
+          if (r->write)
+            block->ops->write (block->aux, r->sector + i, p);
+          else
+            block->ops->read (block->aux, r->sector + i, p);
+        }
+      block_complete (r);
+    }
+}
+
+/* Waits for request R, which must have no callback, to
+   complete. */
+void
+block_wait (struct block_request *r)
+{
+  ASSERT (r->callback == NULL);
+  sema_down (&r->done);
+}
+
+/* Called by a driver, possibly in interrupt context, when
+   request R is done.  Calls R's callback or wakes up the thread
+   waiting for R. */
+void
+block_complete (struct block_request *r)
+{
+  if (r->callback != NULL)
+    r->callback (r);
+  else
+    sema_up (&r->done);
 }
 
 /* Returns the number of sectors in BLOCK. */
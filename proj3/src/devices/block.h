@@ -3,6 +3,8 @@
 
 #include <stddef.h>
 #include <inttypes.h>
+#include <list.h>
+#include "threads/synch.h"
 
 /* Size of a block device sector in bytes.
    All IDE disks use this sector size, as do most USB and SCSI
@@ -53,9 +55,40 @@ struct block *block_next (struct block *);
 block_sector_t block_size (struct block *);
 void block_read (struct block *, block_sector_t, void *);
 void block_write (struct block *, block_sector_t, const void *);
+void block_read_multiple (struct block *, block_sector_t, void *, size_t cnt);
+void block_write_multiple (struct block *, block_sector_t, const void *,
+                           size_t cnt);
 const char *block_name (struct block *);
 enum block_type block_type (struct block *);
 
+/* An asynchronous block request.  Drivers move the data in
+   interrupt context or in a thread of their own, so BUFFER must
+   be in kernel memory. */
+struct block_request
+  {
+    struct list_elem elem;      /* Element in a driver's queue. */
+    block_sector_t sector;      /* First sector. */
+    void *buffer;               /* CNT * BLOCK_SECTOR_SIZE bytes. */
+    size_t cnt;                 /* Number of sectors. */
+    bool write;                 /* Write to device, or read from it? */
+
+    /* If non-null, called when the request completes, possibly
+       in interrupt context, instead of waking block_wait().  It
+       may free the request. */
+    void (*callback) (struct block_request *);
+    void *aux;                  /* For use by CALLBACK. */
+
+    struct semaphore done;      /* Up'd when the request completes. */
+    int64_t deadline;           /* Set by the I/O scheduler. */
+  };
+
+void block_request_init (struct block_request *, block_sector_t,
+                         void *buffer, size_t cnt, bool write,
+                         void (*callback) (struct block_request *),
+                         void *aux);
+void block_submit (struct block *, struct block_request *);
+void block_wait (struct block_request *);
+
 /* Statistics. */
 void block_print_stats (void);
 
@@ -63,12 +96,20 @@ void block_print_stats (void);
 
 struct block_operations
   {
+    /* Synchronous single-sector transfers.  Used only if SUBMIT
+       is null. */
     void (*read) (void *aux, block_sector_t, void *buffer);
     void (*write) (void *aux, block_sector_t, const void *buffer);
+
+    /* Queues a request and returns without waiting for it.  The
+       driver calls block_complete() when the request is done.
+       May be called with interrupts off. */
+    void (*submit) (void *aux, struct block_request *);
   };
 
 struct block *block_register (const char *name, enum block_type,
                               const char *extra_info, block_sector_t size,
                               const struct block_operations *, void *aux);
+void block_complete (struct block_request *);
 
 #endif /* devices/block.h */
@@ -3,15 +3,26 @@
 #include <debug.h>
 #include <stdbool.h>
 #include <stdio.h>
+#include <string.h>
 #include "devices/block.h"
+#include "devices/iosched.h"
 #include "devices/partition.h"
 #include "devices/timer.h"
 #include "threads/io.h"
 #include "threads/interrupt.h"
+#include "threads/palloc.h"
 #include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
 
 /* The code in this file is an interface to an ATA (IDE)
-   controller.  It attempts to comply to [ATA-3]. */
+   controller.  It attempts to comply to [ATA-3].  Data moves by
+   bus-master DMA when a PCI IDE controller that supports it
+   (such as the PIIX emulated by QEMU) is found, and by PIO
+   otherwise. */
+
+/* Use PIO even when bus-master DMA is available? */
+bool ide_pio_only;
 
 /* ATA command block port addresses. */
 #define reg_data(CHANNEL) ((CHANNEL)->reg_base + 0)     /* Data. */
@@ -33,7 +44,9 @@
 /* Alternate Status Register bits. */
 #define STA_BSY 0x80            /* Busy. */
 #define STA_DRDY 0x40           /* Device Ready. */
+#define STA_DF 0x20             /* Device Fault. */
 #define STA_DRQ 0x08            /* Data Request. */
+#define STA_ERR 0x01            /* Error. */
 
 /* Control Register bits. */
 #define CTL_SRST 0x04           /* Software Reset. */
@@ -49,6 +62,52 @@
 #define CMD_IDENTIFY_DEVICE 0xec        /* IDENTIFY DEVICE. */
 #define CMD_READ_SECTOR_RETRY 0x20      /* READ SECTOR with retries. */
 #define CMD_WRITE_SECTOR_RETRY 0x30     /* WRITE SECTOR with retries. */
+#define CMD_READ_DMA 0xc8               /* READ DMA. */
+#define CMD_WRITE_DMA 0xca              /* WRITE DMA. */
+
+/* Bus-master IDE port addresses, relative to the channel's
+   bus-master base port. */
+#define reg_bm_command(CHANNEL) ((CHANNEL)->bm_base + 0) /* Command. */
+#define reg_bm_status(CHANNEL) ((CHANNEL)->bm_base + 2)  /* Status. */
+#define reg_bm_prdt(CHANNEL) ((CHANNEL)->bm_base + 4)    /* PRD Table. */
+
+/* Bus-master Command Register bits. */
+#define BM_CMD_START 0x01       /* Start transfer. */
+#define BM_CMD_READ 0x08        /* Direction: 1=disk to memory. */
+
+/* Bus-master Status Register bits. */
+#define BM_STA_SIMPLEX 0x80     /* Only one channel may transfer. */
+#define BM_STA_IRQ 0x04         /* Interrupt (write 1 to clear). */
+#define BM_STA_ERR 0x02         /* Error (write 1 to clear). */
+
+/* A Physical Region Descriptor.  The bus-master controller
+   walks a table of these to find the memory for a transfer.  A
+   region must be word aligned and may not cross a 64 kB
+   boundary. */
+struct prd
+  {
+    uint32_t addr;              /* Physical address of region. */
+    uint16_t size;              /* Bytes in region, 0 for 64 kB. */
+    uint16_t flags;             /* PRD_EOT in the last entry. */
+  };
+#define PRD_EOT 0x8000          /* End of table. */
+#define PRD_CNT 32              /* Entries in a channel's table. */
+
+/* Maximum number of sectors moved by one command.  A command of
+   IOSCHED_MERGE_MAX merged requests needs at most 2 PRD regions
+   per request plus one per 64 kB it moves, well within
+   PRD_CNT. */
+#define CMD_MAX_SECTORS 256
+
+/* PCI configuration space access. */
+#define PCI_CONFIG_ADDR 0xcf8   /* Configuration address port. */
+#define PCI_CONFIG_DATA 0xcfc   /* Configuration data port. */
+#define PCI_REG_ID 0x00         /* Device and vendor ID. */
+#define PCI_REG_COMMAND 0x04    /* Status and command. */
+#define PCI_REG_CLASS 0x08      /* Class, subclass, interface, revision. */
+#define PCI_REG_BAR4 0x20       /* Base address register 4. */
+#define PCI_CMD_IO 0x0001       /* Respond to I/O space accesses. */
+#define PCI_CMD_BUS_MASTER 0x0004       /* Allow bus mastering. */
 
 /* An ATA device. */
 struct ata_disk
@@ -57,6 +116,8 @@ struct ata_disk
     struct channel *channel;    /* Channel that disk is attached to. */
     int dev_no;                 /* Device 0 or 1 for master or slave. */
     bool is_ata;                /* Is device an ATA disk? */
+    bool use_dma;               /* Transfer data by bus-master DMA? */
+    struct iosched sched;       /* Pending block requests. */
   };
 
 /* An ATA channel (aka controller).
@@ -67,10 +128,36 @@ struct channel
     uint16_t reg_base;          /* Base I/O port. */
     uint8_t irq;                /* Interrupt in use. */
 
-    struct lock lock;           /* Must acquire to access the controller. */
     bool expecting_interrupt;   /* True if an interrupt is expected, false if
                                    any interrupt would be spurious. */
     struct semaphore completion_wait;   /* Up'd by interrupt handler. */
+    uint8_t status;             /* Status read by interrupt handler. */
+    struct semaphore work;      /* Up'd for each request submitted. */
+
+    uint16_t bm_base;           /* Bus-master base port, 0 if no DMA. */
+    struct prd prdt[PRD_CNT] __attribute__ ((aligned (256)));
+                                /* PRD table for DMA transfers. */
+    uint8_t *bounce;            /* Page for DMA to odd-aligned buffers. */
+
+    /* Requests in progress: a batch of requests for consecutive
+       sectors, merged by the I/O scheduler.  Only the channel's
+       thread uses these members, but it changes BATCH with
+       interrupts off, since other channels check whether it is
+       empty. */
+    struct list batch;          /* Requests, in order; empty if idle. */
+    struct ata_disk *batch_disk;        /* Disk they are for. */
+    block_sector_t batch_sector;        /* First sector of batch. */
+    size_t batch_cnt;           /* Sectors in batch. */
+    bool batch_write;           /* Write to disk, or read from it? */
+    size_t batch_done;          /* Sectors finished by past commands. */
+    size_t cmd_cnt;             /* Sectors in the current command. */
+    bool cmd_bounced;           /* Current command uses BOUNCE? */
+    int last_dev_no;            /* Device served most recently. */
+
+    /* Statistics. */
+    unsigned long long cmd_total;       /* Commands issued. */
+    unsigned long long cmd_overlap;     /* ...while the other channel
+                                           was busy too. */
 
     struct ata_disk devices[2];     /* The devices on this channel. */
   };
@@ -85,11 +172,20 @@ static void reset_channel (struct channel *);
 static bool check_device_type (struct ata_disk *);
 static void identify_ata_device (struct ata_disk *);
 
-static void select_sector (struct ata_disk *, block_sector_t);
-static void issue_pio_command (struct channel *, uint8_t command);
+static void select_sectors (struct ata_disk *, block_sector_t, size_t cnt);
+static void issue_command (struct channel *, uint8_t command);
 static void input_sector (struct channel *, void *);
 static void output_sector (struct channel *, const void *);
 
+static thread_func channel_thread;
+static bool take_batch (struct channel *);
+static void run_command (struct channel *);
+static void count_command (struct channel *);
+
+static uint16_t find_bus_master (void);
+static void start_dma (struct channel *);
+static void finish_dma (struct channel *, uint8_t status);
+
 static void wait_until_idle (const struct ata_disk *);
 static bool wait_while_busy (const struct ata_disk *);
 static void select_device (const struct ata_disk *);
@@ -101,8 +197,17 @@ static void interrupt_handler (struct intr_frame *);
 void
 ide_init (void) 
 {
+  uint16_t bm_base;
   size_t chan_no;
 
+  /* Look for a bus-master IDE controller. */
+  bm_base = ide_pio_only ? 0 : find_bus_master ();
+
+  /* Mark every channel idle before any can start a command,
+     since each checks the others for overlap. */
+  for (chan_no = 0; chan_no < CHANNEL_CNT; chan_no++)
+    list_init (&channels[chan_no].batch);
+
   for (chan_no = 0; chan_no < CHANNEL_CNT; chan_no++)
     {
       struct channel *c = &channels[chan_no];
@@ -123,9 +228,28 @@ ide_init (void)
         default:
           NOT_REACHED ();
         }
-      lock_init (&c->lock);
       c->expecting_interrupt = false;
       sema_init (&c->completion_wait, 0);
+      sema_init (&c->work, 0);
+
+      /* Set up bus-master DMA.  Each channel has 8 bus-master
+         ports.  A simplex controller can only DMA on one channel
+         at a time, so use PIO on the secondary channel. */
+      c->bm_base = bm_base != 0 ? bm_base + 8 * chan_no : 0;
+      if (c->bm_base != 0 && chan_no > 0
+          && (inb (reg_bm_status (c)) & BM_STA_SIMPLEX))
+        c->bm_base = 0;
+
+      /* DMA to an odd address goes through a bounce page.  Without
+         one, the channel falls back to PIO. */
+      c->bounce = c->bm_base != 0 ? palloc_get_page (0) : NULL;
+      if (c->bm_base != 0 && c->bounce == NULL)
+        {
+          printf ("%s: no memory for DMA bounce page, using PIO\n", c->name);
+          c->bm_base = 0;
+        }
+      c->last_dev_no = 1;
+      c->cmd_total = c->cmd_overlap = 0;
  
       /* Initialize devices. */
       for (dev_no = 0; dev_no < 2; dev_no++)
@@ -136,6 +260,8 @@ ide_init (void)
           d->channel = c;
           d->dev_no = dev_no;
           d->is_ata = false;
+          d->use_dma = false;
+          iosched_init (&d->sched);
         }
 
       /* Register interrupt handler. */
@@ -148,6 +274,12 @@ ide_init (void)
       if (check_device_type (&c->devices[0]))
         check_device_type (&c->devices[1]);
 
+      /* Start the thread that drives requests, which the
+         partition scan of a disk identified below already
+         needs. */
+      if (c->devices[0].is_ata || c->devices[1].is_ata)
+        thread_create (c->name, PRI_DEFAULT, channel_thread, c);
+
       /* Read hard disk identity information. */
       for (dev_no = 0; dev_no < 2; dev_no++)
         if (c->devices[dev_no].is_ata)
@@ -272,7 +404,7 @@ identify_ata_device (struct ata_disk *d)
      indicating the device's response is ready, and read the data
      into our buffer. */
   select_device_wait (d);
-  issue_pio_command (c, CMD_IDENTIFY_DEVICE);
+  issue_command (c, CMD_IDENTIFY_DEVICE);
   sema_down (&c->completion_wait);
   if (!wait_while_busy (d))
     {
@@ -282,12 +414,15 @@ identify_ata_device (struct ata_disk *d)
   input_sector (c, id);
 
   /* Calculate capacity.
+     Check for DMA support (bit 8 of the capabilities word).
      Read model name and serial number. */
   capacity = *(uint32_t *) &id[60 * 2];
+  d->use_dma = c->bm_base != 0 && (*(uint16_t *) &id[49 * 2] & 0x100);
   model = descramble_ata_string (&id[10 * 2], 20);
   serial = descramble_ata_string (&id[27 * 2], 40);
   snprintf (extra_info, sizeof extra_info,
-            "model \"%s\", serial \"%s\"", model, serial);
+            "model \"%s\", serial \"%s\", %s", model, serial,
+            d->use_dma ? "DMA" : "PIO");
 
   /* Disable access to IDE disks over 1 GB, which are likely
      physical IDE disks rather than virtual ones.  If we don't
@@ -337,63 +472,247 @@ descramble_ata_string (char *string, int size)
   return string;
 }
 
-/* Reads sector SEC_NO from disk D into BUFFER, which must have
-   room for BLOCK_SECTOR_SIZE bytes.
-   Internally synchronizes accesses to disks, so external
-   per-disk locking is unneeded. */
+/* Queues request R for disk D and wakes D's channel's thread,
+   which carries out and completes the batches of requests chosen
+   by the I/O scheduler. */
 static void
-ide_read (void *d_, block_sector_t sec_no, void *buffer)
+ide_submit (void *d_, struct block_request *r)
 {
   struct ata_disk *d = d_;
   struct channel *c = d->channel;
-  lock_acquire (&c->lock);
-  select_sector (d, sec_no);
-  issue_pio_command (c, CMD_READ_SECTOR_RETRY);
-  sema_down (&c->completion_wait);
-  if (!wait_while_busy (d))
-    PANIC ("%s: disk read failed, sector=%"PRDSNu, d->name, sec_no);
-  input_sector (c, buffer);
-  lock_release (&c->lock);
-}
+  enum intr_level old_level = intr_disable ();
 
-/* Write sector SEC_NO to disk D from BUFFER, which must contain
-   BLOCK_SECTOR_SIZE bytes.  Returns after the disk has
-   acknowledged receiving the data.
-   Internally synchronizes accesses to disks, so external
-   per-disk locking is unneeded. */
-static void
-ide_write (void *d_, block_sector_t sec_no, const void *buffer)
-{
-  struct ata_disk *d = d_;
-  struct channel *c = d->channel;
-  lock_acquire (&c->lock);
-  select_sector (d, sec_no);
-  issue_pio_command (c, CMD_WRITE_SECTOR_RETRY);
-  if (!wait_while_busy (d))
-    PANIC ("%s: disk write failed, sector=%"PRDSNu, d->name, sec_no);
-  output_sector (c, buffer);
-  sema_down (&c->completion_wait);
-  lock_release (&c->lock);
+  iosched_add (&d->sched, r);
+  sema_up (&c->work);
+
+  intr_set_level (old_level);
 }
 
 static struct block_operations ide_operations =
   {
-    ide_read,
-    ide_write
+    .submit = ide_submit
   };
-
+
+/* Prints command statistics for each channel in use and I/O
+   scheduler statistics for each disk. */
+void
+ide_print_stats (void) 
+{
+  size_t chan_no;
+  int dev_no;
+
+  for (chan_no = 0; chan_no < CHANNEL_CNT; chan_no++)
+    {
+      struct channel *c = &channels[chan_no];
+
+      if (c->cmd_total > 0)
+        printf ("%s: %llu commands, %llu overlapping other channels\n",
+                c->name, c->cmd_total, c->cmd_overlap);
+      for (dev_no = 0; dev_no < 2; dev_no++)
+        {
+          struct ata_disk *d = &c->devices[dev_no];
+          if (d->is_ata)
+            iosched_print_stats (&d->sched, d->name);
+        }
+    }
+}
+
+/* Thread that drives the requests for channel C_, a batch at a
+   time.  Waiting for the disk, and moving data by PIO, happens
+   here rather than in the interrupt handler, so that it never
+   holds up the rest of the system with interrupts off. */
+static void
+channel_thread (void *c_) 
+{
+  struct channel *c = c_;
+
+  for (;;)
+    {
+      struct list finished;
+      enum intr_level old_level;
+
+      sema_down (&c->work);
+      old_level = intr_disable ();
+      if (!take_batch (c))
+        {
+          /* An earlier batch took this request along. */
+          intr_set_level (old_level);
+          continue;
+        }
+      intr_set_level (old_level);
+
+      while (c->batch_done < c->batch_cnt)
+        run_command (c);
+
+      list_init (&finished);
+      old_level = intr_disable ();
+      while (!list_empty (&c->batch))
+        list_push_back (&finished, list_pop_front (&c->batch));
+      intr_set_level (old_level);
+      while (!list_empty (&finished))
+        block_complete (list_entry (list_pop_front (&finished),
+                                    struct block_request, elem));
+    }
+}
+
+/* If a disk on channel C has pending requests, takes the next
+   batch of them from its I/O scheduler and returns true.
+   Alternates between C's two disks so that neither starves the
+   other.  Returns false if no requests are pending.  C must be
+   idle and interrupts must be off. */
+static bool
+take_batch (struct channel *c)
+{
+  int i;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+  ASSERT (list_empty (&c->batch));
+
+  for (i = 1; i <= 2; i++)
+    {
+      struct ata_disk *d = &c->devices[(c->last_dev_no + i) % 2];
+      if (!iosched_empty (&d->sched))
+        {
+          struct block_request *r;
+
+          c->batch_cnt = iosched_next (&d->sched, &c->batch,
+                                       CMD_MAX_SECTORS);
+          r = list_entry (list_front (&c->batch), struct block_request, elem);
+          c->batch_disk = d;
+          c->batch_sector = r->sector;
+          c->batch_write = r->write;
+          c->batch_done = 0;
+          c->last_dev_no = d->dev_no;
+          return true;
+        }
+    }
+  return false;
+}
+
+/* Counts a command issued on channel C, noting whether another
+   channel has a command in progress at the same time. */
+static void
+count_command (struct channel *c) 
+{
+  struct channel *other;
+
+  c->cmd_total++;
+  for (other = channels; other < channels + CHANNEL_CNT; other++)
+    if (other != c && !list_empty (&other->batch))
+      {
+        c->cmd_overlap++;
+        break;
+      }
+}
+
+/* Returns the address of sector IDX of channel C's batch, within
+   the buffer of the request it belongs to. */
+static uint8_t *
+batch_sector_ptr (struct channel *c, size_t idx) 
+{
+  struct list_elem *e;
+
+  for (e = list_begin (&c->batch); e != list_end (&c->batch);
+       e = list_next (e))
+    {
+      struct block_request *r = list_entry (e, struct block_request, elem);
+      if (idx < r->cnt)
+        return (uint8_t *) r->buffer + idx * BLOCK_SECTOR_SIZE;
+      idx -= r->cnt;
+    }
+  NOT_REACHED ();
+}
+
+/* Carries out a command for as many of the remaining sectors
+   of channel C's batch as one command can move: up to
+   CMD_MAX_SECTORS, or a page of them if DMA goes through the
+   bounce page.  A DMA command interrupts once, when it is done.
+   A PIO command interrupts once per sector, and the sector's
+   data is moved here. */
+static void
+run_command (struct channel *c)
+{
+  struct ata_disk *d = c->batch_disk;
+  uint8_t *p = batch_sector_ptr (c, c->batch_done);
+  block_sector_t sec_no = c->batch_sector + c->batch_done;
+  size_t left = c->batch_cnt - c->batch_done;
+  size_t max_cnt = CMD_MAX_SECTORS;
+  enum intr_level old_level;
+
+  if (d->use_dma)
+    {
+      /* The controller needs word-aligned memory.  The scheduler
+         never merges a request with an odd buffer, so a bounced
+         command covers part of a single request. */
+      c->cmd_bounced = ((uintptr_t) p & 1) != 0;
+      if (c->cmd_bounced)
+        max_cnt = PGSIZE / BLOCK_SECTOR_SIZE;
+    }
+  c->cmd_cnt = left < max_cnt ? left : max_cnt;
+  old_level = intr_disable ();
+  count_command (c);
+  intr_set_level (old_level);
+
+  if (d->use_dma)
+    {
+      if (c->cmd_bounced && c->batch_write)
+        memcpy (c->bounce, p, c->cmd_cnt * BLOCK_SECTOR_SIZE);
+      start_dma (c);
+      sema_down (&c->completion_wait);
+      finish_dma (c, c->status);
+      if (c->cmd_bounced && !c->batch_write)
+        memcpy (p, c->bounce, c->cmd_cnt * BLOCK_SECTOR_SIZE);
+    }
+  else
+    {
+      size_t i;
+
+      select_sectors (d, sec_no, c->cmd_cnt);
+      issue_command (c, c->batch_write ? CMD_WRITE_SECTOR_RETRY
+                                       : CMD_READ_SECTOR_RETRY);
+      for (i = 0; i < c->cmd_cnt; i++)
+        {
+          p = batch_sector_ptr (c, c->batch_done + i);
+          if (c->batch_write)
+            {
+              if (!wait_while_busy (d))
+                PANIC ("%s: disk write failed, sector=%"PRDSNu,
+                       d->name, sec_no + i);
+              output_sector (c, p);
+              sema_down (&c->completion_wait);
+              if ((c->status & (STA_ERR | STA_DF)) != 0)
+                PANIC ("%s: disk write failed, sector=%"PRDSNu,
+                       d->name, sec_no + i);
+            }
+          else
+            {
+              sema_down (&c->completion_wait);
+              if ((c->status & (STA_ERR | STA_DF)) != 0
+                  || !wait_while_busy (d))
+                PANIC ("%s: disk read failed, sector=%"PRDSNu,
+                       d->name, sec_no + i);
+              input_sector (c, p);
+            }
+        }
+    }
+
+  c->expecting_interrupt = false;
+  c->batch_done += c->cmd_cnt;
+}
+
 /* Selects device D, waiting for it to become ready, and then
-   writes SEC_NO to the disk's sector selection registers.  (We
-   use LBA mode.) */
+   writes SEC_NO and CNT, which must be between 1 and 256, to the
+   disk's sector selection registers.  (We use LBA mode.) */
 static void
-select_sector (struct ata_disk *d, block_sector_t sec_no)
+select_sectors (struct ata_disk *d, block_sector_t sec_no, size_t cnt)
 {
   struct channel *c = d->channel;
 
-  ASSERT (sec_no < (1UL << 28));
+  ASSERT (sec_no + cnt <= (1UL << 28));
+  ASSERT (cnt >= 1 && cnt <= 256);
   
   select_device_wait (d);
-  outb (reg_nsect (c), 1);
+  outb (reg_nsect (c), cnt);
   outb (reg_lbal (c), sec_no);
   outb (reg_lbam (c), sec_no >> 8);
   outb (reg_lbah (c), (sec_no >> 16));
@@ -402,14 +721,11 @@ select_sector (struct ata_disk *d, block_sector_t sec_no)
 }
 
 /* Writes COMMAND to channel C and prepares for receiving a
-   completion interrupt. */
+   completion interrupt.  If interrupts are off, the interrupt
+   stays pending until they are turned back on. */
 static void
-issue_pio_command (struct channel *c, uint8_t command) 
+issue_command (struct channel *c, uint8_t command) 
 {
-  /* Interrupts must be enabled or our semaphore will never be
-     up'd by the completion handler. */
-  ASSERT (intr_get_level () == INTR_ON);
-
   c->expecting_interrupt = true;
   outb (reg_command (c), command);
 }
@@ -430,6 +746,183 @@ output_sector (struct channel *c, const void *sector)
   outsw (reg_data (c), sector, BLOCK_SECTOR_SIZE / 2);
 }
 
+/* Bus-master DMA. */
+
+static void setup_prdt (struct channel *);
+static struct prd *add_prd_regions (struct channel *, struct prd *,
+                                    void *region, size_t size);
+
+/* Returns the value of 32-bit register REG in the PCI
+   configuration space of function FUNC of device DEV on bus 0. */
+static uint32_t
+pci_read_config (int dev, int func, int reg) 
+{
+  outl (PCI_CONFIG_ADDR, 0x80000000 | (dev << 11) | (func << 8) | reg);
+  return inl (PCI_CONFIG_DATA);
+}
+
+/* Writes VALUE to 32-bit register REG in the PCI configuration
+   space of function FUNC of device DEV on bus 0. */
+static void
+pci_write_config (int dev, int func, int reg, uint32_t value) 
+{
+  outl (PCI_CONFIG_ADDR, 0x80000000 | (dev << 11) | (func << 8) | reg);
+  outl (PCI_CONFIG_DATA, value);
+}
+
+/* Scans PCI bus 0 for an IDE controller that drives the legacy
+   channels and can act as a bus master.  If one is found,
+   enables bus mastering on it and returns its bus-master base
+   port.  Otherwise, returns 0. */
+static uint16_t
+find_bus_master (void) 
+{
+  int dev, func;
+
+  for (dev = 0; dev < 32; dev++)
+    for (func = 0; func < 8; func++)
+      {
+        uint32_t class, bar, command;
+
+        if ((pci_read_config (dev, func, PCI_REG_ID) & 0xffff) == 0xffff)
+          continue;
+
+        /* Class 1, subclass 1 is an IDE controller.  In the
+           programming interface byte, bit 7 means bus-master
+           capable and bits 0 and 2 mean a channel is in native
+           rather than legacy mode. */
+        class = pci_read_config (dev, func, PCI_REG_CLASS);
+        if ((class >> 16) != 0x0101
+            || (class & 0x8000) == 0
+            || (class & 0x0500) != 0)
+          continue;
+
+        /* BAR4 holds the bus-master ports, in I/O space. */
+        bar = pci_read_config (dev, func, PCI_REG_BAR4);
+        if ((bar & 1) == 0 || (bar & 0xfffc) == 0)
+          continue;
+
+        /* Writing 0 to the status half leaves it unchanged. */
+        command = pci_read_config (dev, func, PCI_REG_COMMAND) & 0xffff;
+        pci_write_config (dev, func, PCI_REG_COMMAND,
+                          command | PCI_CMD_IO | PCI_CMD_BUS_MASTER);
+        return bar & 0xfffc;
+      }
+
+  return 0;
+}
+
+/* Fills in the PRD table of channel C to describe the memory for
+   the current command: the bounce page, or the parts of the
+   buffers of the batch's requests that the command covers. */
+static void
+setup_prdt (struct channel *c) 
+{
+  struct prd *prd = c->prdt;
+
+  if (c->cmd_bounced)
+    prd = add_prd_regions (c, prd, c->bounce,
+                           c->cmd_cnt * BLOCK_SECTOR_SIZE);
+  else
+    {
+      size_t skip = c->batch_done;
+      size_t left = c->cmd_cnt;
+      struct list_elem *e;
+
+      for (e = list_begin (&c->batch); left > 0; e = list_next (e))
+        {
+          struct block_request *r = list_entry (e, struct block_request,
+                                                elem);
+          size_t cnt;
+
+          if (skip >= r->cnt)
+            {
+              skip -= r->cnt;
+              continue;
+            }
+          cnt = r->cnt - skip < left ? r->cnt - skip : left;
+          prd = add_prd_regions (c, prd,
+                                 (uint8_t *) r->buffer
+                                 + skip * BLOCK_SECTOR_SIZE,
+                                 cnt * BLOCK_SECTOR_SIZE);
+          skip = 0;
+          left -= cnt;
+        }
+    }
+  prd[-1].flags = PRD_EOT;
+}
+
+/* Describes the SIZE bytes at kernel address REGION in channel
+   C's PRD table, starting at entry PRD and splitting the region
+   at 64 kB physical boundaries.  Returns the entry after the
+   last one used. */
+static struct prd *
+add_prd_regions (struct channel *c, struct prd *prd, void *region,
+                 size_t size) 
+{
+  uintptr_t addr = vtop (region);
+
+  ASSERT (size > 0);
+
+  while (size > 0)
+    {
+      size_t region_size = 0x10000 - (addr & 0xffff);
+      if (region_size > size)
+        region_size = size;
+
+      ASSERT (prd < c->prdt + PRD_CNT);
+      prd->addr = addr;
+      prd->size = region_size;
+      prd->flags = 0;
+      prd++;
+
+      addr += region_size;
+      size -= region_size;
+    }
+  return prd;
+}
+
+/* Starts the DMA command for the current command of channel
+   C's batch.  The CPU is free until the disk interrupts to say
+   that the command is done. */
+static void
+start_dma (struct channel *c) 
+{
+  uint8_t direction = c->batch_write ? 0 : BM_CMD_READ;
+
+  ASSERT (c->cmd_cnt <= CMD_MAX_SECTORS);
+
+  /* Point the controller at the PRD table and clear any stale
+     error or interrupt status. */
+  setup_prdt (c);
+  outl (reg_bm_prdt (c), vtop (c->prdt));
+  outb (reg_bm_command (c), direction);
+  outb (reg_bm_status (c),
+        inb (reg_bm_status (c)) | BM_STA_ERR | BM_STA_IRQ);
+
+  /* Send the command to the disk, then start the controller. */
+  select_sectors (c->batch_disk, c->batch_sector + c->batch_done,
+                  c->cmd_cnt);
+  issue_command (c, c->batch_write ? CMD_WRITE_DMA : CMD_READ_DMA);
+  outb (reg_bm_command (c), direction | BM_CMD_START);
+}
+
+/* Stops the controller after the DMA command on channel C has
+   interrupted with disk STATUS, and panics if it failed. */
+static void
+finish_dma (struct channel *c, uint8_t status) 
+{
+  uint8_t bm_status;
+
+  outb (reg_bm_command (c), c->batch_write ? 0 : BM_CMD_READ);
+  bm_status = inb (reg_bm_status (c));
+  outb (reg_bm_status (c), bm_status | BM_STA_ERR | BM_STA_IRQ);
+  if ((bm_status & BM_STA_ERR) != 0 || (status & (STA_ERR | STA_DF)) != 0)
+    PANIC ("%s: disk %s failed, sector=%"PRDSNu, c->batch_disk->name,
+           c->batch_write ? "write" : "read",
+           c->batch_sector + c->batch_done);
+}
+
 /* Low-level ATA primitives. */
 
 /* Wait up to 10 seconds for the controller to become idle, that
@@ -489,7 +982,7 @@ select_device (const struct ata_disk *d)
     dev |= DEV_DEV;
   outb (reg_device (c), dev);
   inb (reg_alt_status (c));
-  timer_nsleep (400);
+  timer_ndelay (400);
 }
 
 /* Select disk D in its channel, as select_device(), but wait for
@@ -513,7 +1006,7 @@ interrupt_handler (struct intr_frame *f)
       {
         if (c->expecting_interrupt) 
           {
-            inb (reg_status (c));               /* Acknowledge interrupt. */
+            c->status = inb (reg_status (c));   /* Acknowledge interrupt. */
             sema_up (&c->completion_wait);      /* Wake up waiter. */
           }
         else
@@ -0,0 +1,168 @@
+#include "devices/iosched.h"
+#include <debug.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "threads/interrupt.h"
+
+static bool sector_less (const struct list_elem *, const struct list_elem *,
+                         void *aux);
+static struct block_request *expired (struct iosched *);
+
+/* Initializes scheduler S with an empty queue. */
+void
+iosched_init (struct iosched *s) 
+{
+  list_init (&s->queue);
+  s->head = 0;
+  s->depth = s->max_depth = 0;
+  s->depth_sum = s->request_cnt = 0;
+  s->dispatch_cnt = s->merge_cnt = s->deadline_cnt = 0;
+}
+
+/* Returns true if S has no pending requests. */
+bool
+iosched_empty (struct iosched *s) 
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+  return list_empty (&s->queue);
+}
+
+/* Adds request R to S's queue, in sector order, and sets its
+   deadline. */
+void
+iosched_add (struct iosched *s, struct block_request *r) 
+{
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  r->deadline = timer_ticks () + (r->write ? IOSCHED_WRITE_DEADLINE
+                                           : IOSCHED_READ_DEADLINE);
+  list_insert_ordered (&s->queue, &r->elem, sector_less, NULL);
+
+  s->request_cnt++;
+  s->depth++;
+  s->depth_sum += s->depth;
+  if (s->depth > s->max_depth)
+    s->max_depth = s->depth;
+}
+
+/* Removes the next request to dispatch from S's nonempty queue,
+   along with up to IOSCHED_MERGE_MAX - 1 requests that continue
+   it on disk in the same direction, and appends them to BATCH
+   in sector order.  Requests are merged only while the batch
+   stays within MAX_CNT sectors and only if their buffers are
+   word aligned, as DMA hardware requires.  Returns the number of
+   sectors in BATCH. */
+size_t
+iosched_next (struct iosched *s, struct list *batch, size_t max_cnt) 
+{
+  struct block_request *first, *r;
+  struct list_elem *e;
+  block_sector_t end;
+  size_t cnt, merged;
+  bool aligned;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+  ASSERT (!list_empty (&s->queue));
+
+  /* Choose the first request: an expired one, or else the
+     lowest one at or above HEAD, wrapping around to the lowest
+     one overall. */
+  first = expired (s);
+  if (first != NULL)
+    s->deadline_cnt++;
+  else
+    {
+      for (e = list_begin (&s->queue); e != list_end (&s->queue);
+           e = list_next (e))
+        {
+          r = list_entry (e, struct block_request, elem);
+          if (r->sector >= s->head)
+            {
+              first = r;
+              break;
+            }
+        }
+      if (first == NULL)
+        first = list_entry (list_front (&s->queue),
+                            struct block_request, elem);
+    }
+
+  /* Take FIRST and the requests that continue it. */
+  e = list_remove (&first->elem);
+  list_push_back (batch, &first->elem);
+  cnt = first->cnt;
+  end = first->sector + first->cnt;
+  merged = 1;
+  aligned = ((uintptr_t) first->buffer & 1) == 0;
+  while (aligned && merged < IOSCHED_MERGE_MAX && e != list_end (&s->queue))
+    {
+      r = list_entry (e, struct block_request, elem);
+      if (r->sector > end)
+        break;
+      if (r->sector == end && r->write == first->write
+          && cnt + r->cnt <= max_cnt
+          && ((uintptr_t) r->buffer & 1) == 0)
+        {
+          e = list_remove (e);
+          list_push_back (batch, &r->elem);
+          cnt += r->cnt;
+          end += r->cnt;
+          merged++;
+          s->merge_cnt++;
+        }
+      else
+        e = list_next (e);
+    }
+
+  s->depth -= merged;
+  s->head = end;
+  s->dispatch_cnt++;
+  return cnt;
+}
+
+/* Prints S's statistics, labeled with NAME. */
+void
+iosched_print_stats (const struct iosched *s, const char *name) 
+{
+  unsigned long long avg = (s->request_cnt > 0
+                            ? s->depth_sum * 10 / s->request_cnt : 0);
+
+  printf ("%s: %llu requests in %llu dispatches, %llu merged, "
+          "%llu past deadline\n",
+          name, s->request_cnt, s->dispatch_cnt, s->merge_cnt,
+          s->deadline_cnt);
+  printf ("%s: queue depth %llu.%llu average, %zu maximum\n",
+          name, avg / 10, avg % 10, s->max_depth);
+}
+
+/* Returns true if request A starts at a lower sector than
+   request B. */
+static bool
+sector_less (const struct list_elem *a_, const struct list_elem *b_,
+             void *aux UNUSED) 
+{
+  const struct block_request *a = list_entry (a_, struct block_request, elem);
+  const struct block_request *b = list_entry (b_, struct block_request, elem);
+
+  return a->sector < b->sector;
+}
+
+/* Returns the pending request in S whose deadline passed
+   earliest, or a null pointer if no deadline has passed. */
+static struct block_request *
+expired (struct iosched *s) 
+{
+  int64_t now = timer_ticks ();
+  struct block_request *oldest = NULL;
+  struct list_elem *e;
+
+  for (e = list_begin (&s->queue); e != list_end (&s->queue);
+       e = list_next (e))
+    {
+      struct block_request *r = list_entry (e, struct block_request, elem);
+      if (r->deadline <= now
+          && (oldest == NULL || r->deadline < oldest->deadline))
+        oldest = r;
+    }
+  return oldest;
+}
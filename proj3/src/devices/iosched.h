@@ -0,0 +1,55 @@
+#ifndef DEVICES_IOSCHED_H
+#define DEVICES_IOSCHED_H
+
+#include <list.h>
+#include <stddef.h>
+#include "devices/block.h"
+#include "devices/timer.h"
+
+/* An elevator I/O scheduler for the request queue of one disk.
+
+   Pending requests are kept sorted by sector and dispatched in
+   C-LOOK order: upward from the last request dispatched, then
+   back to the lowest pending sector.  Each dispatch also takes
+   the requests that continue the first one on disk in the same
+   direction, so that the driver can move them all with a single
+   command.  A read that has waited past its deadline is
+   dispatched ahead of its turn, so that a stream of requests
+   elsewhere on the disk cannot starve it.  Requests for
+   overlapping sectors may be dispatched in any order, so callers
+   must not have such requests pending at once.
+
+   Scheduler functions can be called from kernel threads or from
+   external interrupt handlers.  Except for iosched_init(),
+   interrupts must be off in either case. */
+
+/* Time, in timer ticks, after which a pending read or write is
+   dispatched ahead of its turn. */
+#define IOSCHED_READ_DEADLINE (TIMER_FREQ / 20)
+#define IOSCHED_WRITE_DEADLINE (TIMER_FREQ / 2)
+
+/* Maximum number of requests merged into one dispatch. */
+#define IOSCHED_MERGE_MAX 8
+
+struct iosched
+  {
+    struct list queue;          /* Pending requests, sorted by sector. */
+    block_sector_t head;        /* Sector after the last dispatch. */
+
+    /* Statistics. */
+    size_t depth;               /* Current number of pending requests. */
+    size_t max_depth;           /* Largest DEPTH seen. */
+    unsigned long long depth_sum;       /* Sum of DEPTH seen by adds. */
+    unsigned long long request_cnt;     /* Requests added. */
+    unsigned long long dispatch_cnt;    /* Dispatches. */
+    unsigned long long merge_cnt;       /* Requests merged into one. */
+    unsigned long long deadline_cnt;    /* Dispatches made early. */
+  };
+
+void iosched_init (struct iosched *);
+bool iosched_empty (struct iosched *);
+void iosched_add (struct iosched *, struct block_request *);
+size_t iosched_next (struct iosched *, struct list *batch, size_t max_cnt);
+void iosched_print_stats (const struct iosched *, const char *name);
+
+#endif /* devices/iosched.h */
@@ -0,0 +1,627 @@
+#include "filesys/cache.h"
+#include <debug.h>
+#include <stdio.h>
+#include <string.h>
+#include "devices/timer.h"
+#include "filesys/filesys.h"
+#include "filesys/journal.h"
+#include "threads/palloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+
+/* A buffer cache entry.
+
+   IN_USE and SECTOR may only be changed by a thread holding both
+   CACHE_LOCK and the entry's LOCK, so holding either one is
+   enough to read them.  ACCESSED and EVICTING are protected by
+   CACHE_LOCK.  The remaining fields and the sector data are
+   protected by the entry's LOCK alone. */
+struct cache_entry
+  {
+    block_sector_t sector;      /* Sector cached here, if IN_USE. */
+    bool in_use;                /* Does this entry hold a sector? */
+    bool accessed;              /* Used since the clock hand passed? */
+    bool evicting;              /* Being written back for reuse? */
+
+    struct lock lock;           /* Protects the members below. */
+    bool loaded;                /* Has DATA been read from disk? */
+    bool dirty;                 /* Does DATA need to be written back? */
+    bool prefetched;            /* Read ahead and not yet used? */
+    bool pinned;                /* Must not be written back yet? */
+    uint8_t *data;              /* BLOCK_SECTOR_SIZE bytes of data. */
+  };
+
+/* The cache. */
+static struct cache_entry cache[CACHE_SIZE];
+
+/* Protects the sector-to-entry mapping and the clock hand. */
+static struct lock cache_lock;
+
+/* Next entry for the clock algorithm to consider. */
+static size_t clock_hand;
+
+/* Maximum number of writes cache_flush() has in flight. */
+#define FLUSH_BATCH 8
+
+/* Write-behind tunables. */
+unsigned cache_flush_ms = 1000;
+unsigned cache_dirty_pct = 50;
+
+/* Number of dirty entries, protected by DIRTY_LOCK. */
+static size_t dirty_cnt;
+static struct lock dirty_lock;
+
+/* Sectors waiting to be read ahead, as a circular queue. */
+#define READAHEAD_QUEUE_SIZE 32
+static block_sector_t readahead_queue[READAHEAD_QUEUE_SIZE];
+static size_t readahead_head;           /* Index of oldest request. */
+static size_t readahead_cnt;            /* Number of queued requests. */
+static struct lock readahead_lock;      /* Protects the queue. */
+static struct condition readahead_cond; /* Signaled when queue nonempty. */
+
+/* Statistics, protected by STAT_LOCK. */
+static struct lock stat_lock;
+static unsigned long long hit_cnt;      /* Lookups satisfied by the cache. */
+static unsigned long long miss_cnt;     /* Lookups that went to disk. */
+static unsigned long long writeback_cnt; /* Dirty sectors written back. */
+static unsigned long long prefetch_cnt; /* Sectors read ahead. */
+static unsigned long long prefetch_hit_cnt;   /* ...later used. */
+static unsigned long long prefetch_waste_cnt; /* ...evicted unused. */
+static unsigned long long throttle_cnt; /* Writes made to flush. */
+static unsigned long long direct_cnt;   /* Sectors read around the cache. */
+
+static struct cache_entry *cache_get (block_sector_t, bool load);
+static struct cache_entry *lookup (block_sector_t);
+static struct cache_entry *evict (void);
+static void set_dirty (struct cache_entry *, bool);
+static void count (unsigned long long *, size_t);
+static bool crosses_page (const void *);
+static void write_back (size_t max_cnt);
+static void write_at (block_sector_t, const void *, int ofs, int size,
+                      bool pin);
+static thread_func readahead_daemon NO_RETURN;
+static thread_func flush_daemon NO_RETURN;
+static void prefetch (block_sector_t);
+
+/* Initializes the buffer cache. */
+void
+cache_init (void)
+{
+  uint8_t *data;
+  size_t i;
+
+  data = palloc_get_multiple (PAL_ASSERT,
+                              CACHE_SIZE * BLOCK_SECTOR_SIZE / PGSIZE);
+  lock_init (&cache_lock);
+  for (i = 0; i < CACHE_SIZE; i++)
+    {
+      struct cache_entry *e = &cache[i];
+      e->in_use = false;
+      e->accessed = false;
+      e->evicting = false;
+      lock_init (&e->lock);
+      e->loaded = false;
+      e->dirty = false;
+      e->prefetched = false;
+      e->pinned = false;
+      e->data = data + i * BLOCK_SECTOR_SIZE;
+    }
+
+  lock_init (&dirty_lock);
+  lock_init (&stat_lock);
+  lock_init (&readahead_lock);
+  cond_init (&readahead_cond);
+  thread_create ("read-ahead", PRI_DEFAULT, readahead_daemon, NULL);
+  if (cache_flush_ms > 0)
+    thread_create ("write-behind", PRI_DEFAULT, flush_daemon, NULL);
+}
+
+/* Shuts down the buffer cache, writing all dirty sectors back to
+   disk. */
+void
+cache_done (void)
+{
+  cache_flush ();
+}
+
+/* Writes every dirty sector in the cache back to disk, except
+   for pinned sectors. */
+void
+cache_flush (void)
+{
+  write_back (CACHE_SIZE);
+}
+
+/* Reads SECTOR into BUFFER, which must have room for
+   BLOCK_SECTOR_SIZE bytes. */
+void
+cache_read (block_sector_t sector, void *buffer)
+{
+  cache_read_at (sector, buffer, 0, BLOCK_SECTOR_SIZE);
+}
+
+/* Copies SIZE bytes starting at byte offset OFS within SECTOR
+   into BUFFER. */
+void
+cache_read_at (block_sector_t sector, void *buffer, int ofs, int size)
+{
+  struct cache_entry *e;
+
+  ASSERT (ofs >= 0 && size >= 0 && ofs + size <= BLOCK_SECTOR_SIZE);
+
+  e = cache_get (sector, true);
+  memcpy (buffer, e->data + ofs, size);
+  lock_release (&e->lock);
+}
+
+/* Reads the CNT sectors starting at SECTOR into BUFFER, which
+   must have room for CNT * BLOCK_SECTOR_SIZE bytes, like
+   cache_read(), except that sectors that are not cached are read
+   from disk straight into BUFFER without being added to the
+   cache, each run of them with a single block request.  Large
+   reads use this to avoid a copy per sector and to keep from
+   flushing the cache.  A dirty sector stays in the cache until
+   its write-back completes, so a sector not found in the cache
+   is up to date on disk.  A sector that would cross a page
+   boundary of a user BUFFER cannot be read by the disk into one
+   kernel frame, so it goes through the cache too. */
+void
+cache_read_direct (block_sector_t sector, void *buffer, size_t cnt)
+{
+  uint8_t *p = buffer;
+
+  while (cnt > 0)
+    {
+      size_t run;
+
+      lock_acquire (&cache_lock);
+      for (run = 0; run < cnt && lookup (sector + run) == NULL
+                    && !crosses_page (p + run * BLOCK_SECTOR_SIZE); run++)
+        continue;
+      lock_release (&cache_lock);
+
+      if (run == 0)
+        {
+          cache_read (sector, p);
+          run = 1;
+        }
+      else
+        {
+          block_read_multiple (fs_device, sector, p, run);
+          count (&direct_cnt, run);
+        }
+
+      sector += run;
+      p += run * BLOCK_SECTOR_SIZE;
+      cnt -= run;
+    }
+}
+
+/* Writes BLOCK_SECTOR_SIZE bytes from BUFFER into SECTOR. */
+void
+cache_write (block_sector_t sector, const void *buffer)
+{
+  cache_write_at (sector, buffer, 0, BLOCK_SECTOR_SIZE);
+}
+
+/* Copies SIZE bytes from BUFFER into SECTOR, starting at byte
+   offset OFS within the sector.  The sector is written to disk
+   later by the write-behind thread, on eviction, or when the
+   cache is flushed.  Only if more than CACHE_DIRTY_PCT percent
+   of the cache is dirty does the caller wait for disk writes,
+   and then only for enough of them to get back under the
+   limit. */
+void
+cache_write_at (block_sector_t sector, const void *buffer, int ofs, int size)
+{
+  write_at (sector, buffer, ofs, size, false);
+}
+
+/* Like cache_write_at(), but also pins SECTOR in the cache: it
+   will not be written to disk until cache_unpin() is called for
+   it.  The journal uses this to keep metadata changes off disk
+   until they have been committed. */
+void
+cache_write_pinned (block_sector_t sector, const void *buffer,
+                    int ofs, int size)
+{
+  write_at (sector, buffer, ofs, size, true);
+}
+
+/* Writes SECTOR, which must have been pinned with
+   cache_write_pinned(), back to disk and unpins it. */
+void
+cache_unpin (block_sector_t sector)
+{
+  struct cache_entry *e = cache_get (sector, true);
+
+  ASSERT (e->pinned);
+  if (e->dirty)
+    {
+      block_write (fs_device, e->sector, e->data);
+      set_dirty (e, false);
+      count (&writeback_cnt, 1);
+    }
+  e->pinned = false;
+  lock_release (&e->lock);
+}
+
+/* Writes SECTOR back to disk if it is dirty and not pinned, and
+   returns once the disk has it. */
+void
+cache_sync (block_sector_t sector)
+{
+  struct cache_entry *e = cache_get (sector, true);
+
+  if (e->dirty && !e->pinned)
+    {
+      block_write (fs_device, e->sector, e->data);
+      set_dirty (e, false);
+      count (&writeback_cnt, 1);
+    }
+  lock_release (&e->lock);
+}
+
+/* Asks the read-ahead daemon to bring SECTOR into the cache in
+   the background.  The request is dropped if the daemon is too
+   far behind. */
+void
+cache_readahead (block_sector_t sector)
+{
+  lock_acquire (&readahead_lock);
+  if (readahead_cnt < READAHEAD_QUEUE_SIZE)
+    {
+      size_t tail = (readahead_head + readahead_cnt) % READAHEAD_QUEUE_SIZE;
+      readahead_queue[tail] = sector;
+      readahead_cnt++;
+      cond_signal (&readahead_cond, &readahead_lock);
+    }
+  lock_release (&readahead_lock);
+}
+
+/* Prints buffer cache statistics. */
+void
+cache_print_stats (void)
+{
+  lock_acquire (&stat_lock);
+  printf ("Cache: %llu hits, %llu misses, %llu writebacks\n",
+          hit_cnt, miss_cnt, writeback_cnt);
+  printf ("Read-ahead: %llu sectors, %llu used, %llu wasted\n",
+          prefetch_cnt, prefetch_hit_cnt, prefetch_waste_cnt);
+  printf ("Write-behind: %llu throttled writes\n", throttle_cnt);
+  printf ("Direct reads: %llu sectors\n", direct_cnt);
+  lock_release (&stat_lock);
+}
+
+/* Copies SIZE bytes from BUFFER into SECTOR, starting at byte
+   offset OFS within the sector, and pins the sector if PIN is
+   true. */
+static void
+write_at (block_sector_t sector, const void *buffer, int ofs, int size,
+          bool pin)
+{
+  struct cache_entry *e;
+  size_t dirty_max = (size_t) CACHE_SIZE * cache_dirty_pct / 100;
+  size_t dirty;
+
+  ASSERT (ofs >= 0 && size >= 0 && ofs + size <= BLOCK_SECTOR_SIZE);
+
+  /* A write of the whole sector need not read the old data. */
+  e = cache_get (sector, size < BLOCK_SECTOR_SIZE);
+  memcpy (e->data + ofs, buffer, size);
+  e->loaded = true;
+  set_dirty (e, true);
+  if (pin)
+    e->pinned = true;
+  lock_release (&e->lock);
+
+  dirty = dirty_cnt;
+  if (dirty > dirty_max)
+    {
+      count (&throttle_cnt, 1);
+      write_back (dirty - dirty_max);
+    }
+}
+
+/* Marks entry E, whose lock must be held, as DIRTY or clean and
+   keeps the count of dirty entries up to date. */
+static void
+set_dirty (struct cache_entry *e, bool dirty)
+{
+  ASSERT (lock_held_by_current_thread (&e->lock));
+
+  if (e->dirty != dirty)
+    {
+      e->dirty = dirty;
+      lock_acquire (&dirty_lock);
+      if (dirty)
+        dirty_cnt++;
+      else
+        dirty_cnt--;
+      lock_release (&dirty_lock);
+    }
+}
+
+/* Writes up to MAX_CNT dirty sectors back to disk, skipping
+   pinned sectors.  Up to FLUSH_BATCH writes are queued on the
+   device at once, so that the disk moves from one to the next
+   without waiting for this thread. */
+static void
+write_back (size_t max_cnt)
+{
+  struct block_request requests[FLUSH_BATCH];
+  struct cache_entry *batch[FLUSH_BATCH];
+  size_t batch_cnt = 0;
+  size_t i;
+
+  for (i = 0; i < CACHE_SIZE && max_cnt > 0; i++)
+    {
+      struct cache_entry *e = &cache[i];
+
+      /* Entries are locked in index order, and stay locked until
+         their writes complete. */
+      lock_acquire (&e->lock);
+      if (e->in_use && e->dirty && !e->pinned)
+        {
+          struct block_request *r = &requests[batch_cnt];
+          block_request_init (r, e->sector, e->data, 1, true, NULL, NULL);
+          block_submit (fs_device, r);
+          batch[batch_cnt++] = e;
+          max_cnt--;
+        }
+      else
+        lock_release (&e->lock);
+
+      if (batch_cnt == FLUSH_BATCH
+          || (batch_cnt > 0 && (i == CACHE_SIZE - 1 || max_cnt == 0)))
+        {
+          size_t j;
+
+          for (j = 0; j < batch_cnt; j++)
+            {
+              block_wait (&requests[j]);
+              set_dirty (batch[j], false);
+              count (&writeback_cnt, 1);
+              lock_release (&batch[j]->lock);
+            }
+          batch_cnt = 0;
+        }
+    }
+}
+
+
+/* Adds N to the statistic *CNT. */
+static void
+count (unsigned long long *cnt, size_t n)
+{
+  lock_acquire (&stat_lock);
+  *cnt += n;
+  lock_release (&stat_lock);
+}
+
+/* Returns true if the sector-sized user buffer at P crosses a
+   page boundary. */
+static bool
+crosses_page (const void *p)
+{
+  return is_user_vaddr (p) && pg_ofs (p) > PGSIZE - BLOCK_SECTOR_SIZE;
+}
+
+/* Write-behind thread.  Every CACHE_FLUSH_MS milliseconds,
+   commits the running journal transaction and writes dirty
+   sectors back. */
+static void
+flush_daemon (void *aux UNUSED)
+{
+  int64_t ticks = (int64_t) cache_flush_ms * TIMER_FREQ / 1000;
+
+  if (ticks < 1)
+    ticks = 1;
+  for (;;)
+    {
+      timer_sleep (ticks);
+      journal_commit ();
+      if (dirty_cnt > 0)
+        cache_flush ();
+    }
+}
+
+/* Read-ahead thread.  Services requests queued by
+   cache_readahead(), one sector at a time. */
+static void
+readahead_daemon (void *aux UNUSED)
+{
+  for (;;)
+    {
+      block_sector_t sector;
+
+      lock_acquire (&readahead_lock);
+      while (readahead_cnt == 0)
+        cond_wait (&readahead_cond, &readahead_lock);
+      sector = readahead_queue[readahead_head];
+      readahead_head = (readahead_head + 1) % READAHEAD_QUEUE_SIZE;
+      readahead_cnt--;
+      lock_release (&readahead_lock);
+
+      prefetch (sector);
+    }
+}
+
+/* Reads SECTOR into the cache unless it is already there. */
+static void
+prefetch (block_sector_t sector)
+{
+  struct cache_entry *e;
+
+  lock_acquire (&cache_lock);
+  if (lookup (sector) != NULL)
+    {
+      lock_release (&cache_lock);
+      return;
+    }
+  e = evict ();
+  if (e == NULL || lookup (sector) != NULL)
+    {
+      /* No entry was free, or SECTOR was cached by another thread
+         while the victim was written back. */
+      if (e != NULL)
+        lock_release (&e->lock);
+      lock_release (&cache_lock);
+      return;
+    }
+  e->in_use = true;
+  e->sector = sector;
+  e->accessed = true;
+  lock_release (&cache_lock);
+
+  block_read (fs_device, sector, e->data);
+  e->loaded = true;
+  e->prefetched = true;
+  count (&prefetch_cnt, 1);
+  lock_release (&e->lock);
+}
+
+/* Returns the cache entry for SECTOR with its lock held,
+   allocating an entry if SECTOR is not cached.  If LOAD is true,
+   the entry's data is read from disk if it is not already
+   present; otherwise the caller must overwrite all of it. */
+static struct cache_entry *
+cache_get (block_sector_t sector, bool load)
+{
+  struct cache_entry *e;
+
+  for (;;)
+    {
+      lock_acquire (&cache_lock);
+      e = lookup (sector);
+      if (e != NULL)
+        {
+          /* An entry being evicted is waited for like any other,
+             but it will be free by the time we get its lock, and
+             the lookup is retried. */
+          if (!e->evicting)
+            e->accessed = true;
+          lock_release (&cache_lock);
+
+          /* The entry may be recycled while we wait for it. */
+          lock_acquire (&e->lock);
+          if (e->in_use && e->sector == sector)
+            {
+              count (&hit_cnt, 1);
+              if (e->prefetched)
+                {
+                  e->prefetched = false;
+                  count (&prefetch_hit_cnt, 1);
+                }
+              break;
+            }
+          lock_release (&e->lock);
+          continue;
+        }
+
+      e = evict ();
+      if (e != NULL && lookup (sector) != NULL)
+        {
+          /* SECTOR was cached by another thread while the victim
+             was written back.  Leave the victim free and retry. */
+          lock_release (&e->lock);
+          lock_release (&cache_lock);
+          continue;
+        }
+      if (e != NULL)
+        {
+          e->in_use = true;
+          e->sector = sector;
+          e->accessed = true;
+          e->loaded = false;
+          e->prefetched = false;
+          lock_release (&cache_lock);
+          count (&miss_cnt, 1);
+          break;
+        }
+
+      /* Every entry is busy.  Let their holders finish. */
+      lock_release (&cache_lock);
+      thread_yield ();
+    }
+
+  if (load && !e->loaded)
+    {
+      block_read (fs_device, sector, e->data);
+      e->loaded = true;
+    }
+  return e;
+}
+
+/* Returns the entry that caches SECTOR, or a null pointer if
+   there is none.  The cache lock must be held. */
+static struct cache_entry *
+lookup (block_sector_t sector)
+{
+  size_t i;
+
+  ASSERT (lock_held_by_current_thread (&cache_lock));
+
+  for (i = 0; i < CACHE_SIZE; i++)
+    if (cache[i].in_use && cache[i].sector == sector)
+      return &cache[i];
+  return NULL;
+}
+
+/* Chooses an entry to reuse with the clock algorithm, writes it
+   back to disk if it is dirty, and returns it unused with its
+   lock held.  Entries locked by other threads and pinned entries
+   are skipped.
+   Returns a null pointer if no entry could be claimed.  The
+   cache lock must be held.  It is released while a dirty victim
+   is written back, so the caller must look up its sector again
+   after a victim is returned. */
+static struct cache_entry *
+evict (void)
+{
+  size_t i;
+
+  ASSERT (lock_held_by_current_thread (&cache_lock));
+
+  /* Two sweeps: the first may only clear accessed bits. */
+  for (i = 0; i < 2 * CACHE_SIZE; i++)
+    {
+      struct cache_entry *e = &cache[clock_hand];
+      clock_hand = (clock_hand + 1) % CACHE_SIZE;
+
+      if (e->in_use && e->accessed)
+        {
+          e->accessed = false;
+          continue;
+        }
+      if (!lock_try_acquire (&e->lock))
+        continue;
+      if (e->in_use && e->pinned)
+        {
+          lock_release (&e->lock);
+          continue;
+        }
+
+      /* The entry keeps its sector while it is written back, so
+         that a thread looking for the sector waits for its lock
+         instead of reading the stale copy from disk, but the rest
+         of the cache stays usable meanwhile. */
+      if (e->in_use && e->dirty)
+        {
+          e->evicting = true;
+          lock_release (&cache_lock);
+          block_write (fs_device, e->sector, e->data);
+          set_dirty (e, false);
+          count (&writeback_cnt, 1);
+          lock_acquire (&cache_lock);
+          e->evicting = false;
+        }
+      if (e->in_use && e->prefetched)
+        count (&prefetch_waste_cnt, 1);
+      e->in_use = false;
+      e->prefetched = false;
+      return e;
+    }
+  return NULL;
+}
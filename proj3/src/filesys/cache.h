@@ -0,0 +1,36 @@
+#ifndef FILESYS_CACHE_H
+#define FILESYS_CACHE_H
+
+#include <stdbool.h>
+#include "devices/block.h"
+
+/* Number of sectors held in the buffer cache. */
+#define CACHE_SIZE 64
+
+/* Milliseconds between write-behind passes, or 0 to write dirty
+   sectors back only on eviction and when the cache fills with
+   them.  Controlled by kernel command-line option "-flush=MS". */
+extern unsigned cache_flush_ms;
+
+/* Percentage of the cache that may be dirty before writers must
+   write sectors back themselves.  Controlled by kernel
+   command-line option "-dirty=PCT". */
+extern unsigned cache_dirty_pct;
+
+void cache_init (void);
+void cache_done (void);
+void cache_flush (void);
+
+void cache_read (block_sector_t, void *);
+void cache_read_at (block_sector_t, void *, int ofs, int size);
+void cache_read_direct (block_sector_t, void *, size_t cnt);
+void cache_write (block_sector_t, const void *);
+void cache_write_at (block_sector_t, const void *, int ofs, int size);
+void cache_write_pinned (block_sector_t, const void *, int ofs, int size);
+void cache_unpin (block_sector_t);
+void cache_sync (block_sector_t);
+void cache_readahead (block_sector_t);
+
+void cache_print_stats (void);
+
+#endif /* filesys/cache.h */
@@ -0,0 +1,178 @@
+#include "filesys/dcache.h"
+#include <debug.h>
+#include <hash.h>
+#include <list.h>
+#include <stdio.h>
+#include <string.h>
+#include "filesys/directory.h"
+#include "threads/synch.h"
+
+/* A cached name lookup: NAME in the directory whose inode is in
+   sector DIR resolves to the inode in SECTOR, or does not exist
+   if SECTOR is DCACHE_NEGATIVE. */
+struct dentry
+  {
+    struct hash_elem hash_elem; /* Element in DENTRIES, if in use. */
+    struct list_elem list_elem; /* Element in LRU_LIST or FREE_LIST. */
+    block_sector_t dir;         /* Directory inode sector. */
+    block_sector_t sector;      /* File inode sector. */
+    char name[NAME_MAX + 1];    /* Null terminated file name. */
+  };
+
+/* The cache.  Entries in use are in DENTRIES and in LRU_LIST,
+   most recently used first; the rest are in FREE_LIST. */
+static struct dentry dentry_pool[DCACHE_SIZE];
+static struct hash dentries;
+static struct list lru_list;
+static struct list free_list;
+
+/* Protects all of the above. */
+static struct lock dcache_lock;
+
+/* Statistics. */
+static unsigned long long hit_cnt;      /* Lookups answered. */
+static unsigned long long negative_cnt; /* ...that found no file. */
+static unsigned long long miss_cnt;     /* Lookups not answered. */
+
+static hash_hash_func dentry_hash;
+static hash_less_func dentry_less;
+static struct dentry *find (block_sector_t dir, const char *name);
+
+/* Initializes the dentry cache. */
+void
+dcache_init (void)
+{
+  size_t i;
+
+  if (!hash_init (&dentries, dentry_hash, dentry_less, NULL))
+    PANIC ("out of memory for dentry cache");
+  list_init (&lru_list);
+  list_init (&free_list);
+  for (i = 0; i < DCACHE_SIZE; i++)
+    list_push_back (&free_list, &dentry_pool[i].list_elem);
+  lock_init (&dcache_lock);
+}
+
+/* Looks up NAME in the directory whose inode is in sector DIR.
+   If the answer is cached, stores the file's inode sector, or
+   DCACHE_NEGATIVE if there is no such file, into *SECTORP and
+   returns true.  Otherwise, returns false. */
+bool
+dcache_lookup (block_sector_t dir, const char *name, block_sector_t *sectorp)
+{
+  struct dentry *d;
+
+  lock_acquire (&dcache_lock);
+  d = find (dir, name);
+  if (d != NULL)
+    {
+      list_remove (&d->list_elem);
+      list_push_front (&lru_list, &d->list_elem);
+      *sectorp = d->sector;
+      hit_cnt++;
+      if (d->sector == DCACHE_NEGATIVE)
+        negative_cnt++;
+    }
+  else
+    miss_cnt++;
+  lock_release (&dcache_lock);
+
+  return d != NULL;
+}
+
+/* Records that NAME in the directory whose inode is in sector
+   DIR resolves to SECTOR, which may be DCACHE_NEGATIVE, evicting
+   the least recently used entry if the cache is full. */
+void
+dcache_insert (block_sector_t dir, const char *name, block_sector_t sector)
+{
+  struct dentry *d;
+
+  ASSERT (strlen (name) <= NAME_MAX);
+
+  lock_acquire (&dcache_lock);
+  d = find (dir, name);
+  if (d != NULL)
+    list_remove (&d->list_elem);
+  else
+    {
+      if (!list_empty (&free_list))
+        d = list_entry (list_pop_front (&free_list), struct dentry, list_elem);
+      else
+        {
+          d = list_entry (list_pop_back (&lru_list), struct dentry, list_elem);
+          hash_delete (&dentries, &d->hash_elem);
+        }
+      d->dir = dir;
+      strlcpy (d->name, name, sizeof d->name);
+      hash_insert (&dentries, &d->hash_elem);
+    }
+  d->sector = sector;
+  list_push_front (&lru_list, &d->list_elem);
+  lock_release (&dcache_lock);
+}
+
+/* Forgets anything cached about NAME in the directory whose
+   inode is in sector DIR. */
+void
+dcache_invalidate (block_sector_t dir, const char *name)
+{
+  struct dentry *d;
+
+  lock_acquire (&dcache_lock);
+  d = find (dir, name);
+  if (d != NULL)
+    {
+      hash_delete (&dentries, &d->hash_elem);
+      list_remove (&d->list_elem);
+      list_push_front (&free_list, &d->list_elem);
+    }
+  lock_release (&dcache_lock);
+}
+
+/* Prints dentry cache statistics. */
+void
+dcache_print_stats (void)
+{
+  printf ("Dentry cache: %llu hits (%llu negative), %llu misses\n",
+          hit_cnt, negative_cnt, miss_cnt);
+}
+
+/* Returns the entry for NAME in directory DIR, or a null pointer
+   if there is none.  The dentry cache lock must be held. */
+static struct dentry *
+find (block_sector_t dir, const char *name)
+{
+  struct dentry key;
+  struct hash_elem *e;
+
+  ASSERT (lock_held_by_current_thread (&dcache_lock));
+
+  if (strlen (name) > NAME_MAX)
+    return NULL;
+  key.dir = dir;
+  strlcpy (key.name, name, sizeof key.name);
+  e = hash_find (&dentries, &key.hash_elem);
+  return e != NULL ? hash_entry (e, struct dentry, hash_elem) : NULL;
+}
+
+/* Returns a hash value for dentry E. */
+static unsigned
+dentry_hash (const struct hash_elem *e, void *aux UNUSED)
+{
+  const struct dentry *d = hash_entry (e, struct dentry, hash_elem);
+  return hash_string (d->name) ^ hash_int (d->dir);
+}
+
+/* Returns true if dentry A precedes dentry B. */
+static bool
+dentry_less (const struct hash_elem *a_, const struct hash_elem *b_,
+             void *aux UNUSED)
+{
+  const struct dentry *a = hash_entry (a_, struct dentry, hash_elem);
+  const struct dentry *b = hash_entry (b_, struct dentry, hash_elem);
+
+  if (a->dir != b->dir)
+    return a->dir < b->dir;
+  return strcmp (a->name, b->name) < 0;
+}
@@ -1,7 +1,13 @@
 #include "filesys/directory.h"
+#include <hash.h>
+#include <limits.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <list.h>
+#include <round.h>
+#include <dirent.h>
+#include "filesys/dcache.h"
 #include "filesys/filesys.h"
 #include "filesys/inode.h"
 #include "threads/malloc.h"
@@ -21,12 +27,90 @@ struct dir_entry
     bool in_use;                        /* In use or free? */
   };
 
+/* Directory layout.
+
+   A small directory is a plain array of dir_entry structures
+   that is searched linearly.  Once a linear directory holding
+   LINEAR_MAX entries needs another slot, it is converted to a
+   hashed directory: sector 0 starts with a dir_header, and
+   each of the following BUCKET_CNT sectors is a bucket of
+   BUCKET_ENTRIES entries.  An entry for NAME is kept in bucket
+   hash_string(NAME) % BUCKET_CNT, so a lookup reads a single
+   bucket.
+
+   Converting a linear directory rewrites it whole, with
+   MIN_BUCKETS buckets, or up to CONVERT_BUCKETS if some bucket
+   would be full.  After that, when an entry's bucket is full,
+   the directory doubles its number of buckets a few at a time,
+   so that no journal operation has to rewrite the whole
+   directory.  Splitting bucket B moves the entries that belong
+   in bucket B + BUCKET_CNT of the doubled directory there.
+   While a doubling is under way, the header records which
+   buckets have been split, and NAME's bucket is
+   hash_string(NAME) % (2 * BUCKET_CNT) if bucket
+   hash_string(NAME) % BUCKET_CNT has been split.  dir_add()
+   splits the full bucket, if it has not been split yet, and
+   other buckets up to GROW_STEP in all.  It fails if the
+   bucket is still full after that, or if the directory already
+   has MAX_BUCKETS buckets. */
+#define LINEAR_MAX 50
+#define BUCKET_ENTRIES (BLOCK_SECTOR_SIZE / sizeof (struct dir_entry))
+#define MIN_BUCKETS 8
+#define CONVERT_BUCKETS 32
+#define MAX_BUCKETS 1024
+#define GROW_STEP 4
+
+/* Most sectors that one step of growth changes through the
+   journal: the directory's inode, the header, and its extent
+   tree root; for each bucket split, that bucket, the one it
+   splits into, and up to two extent tree leaves for the latter;
+   and the bucket that the new entry then goes into, along with
+   two more leaves. */
+#define GROW_JOURNAL_MAX (6 + 4 * GROW_STEP)
+
+/* Identifies a hashed directory. */
+#define DIR_HASH_MAGIC 0x48534944
+
+/* Start of the first sector of a hashed directory.  Its first
+   slot lines up with struct dir_entry so that IN_USE is always
+   false. */
+struct dir_header
+  {
+    uint32_t magic;                     /* DIR_HASH_MAGIC. */
+    uint32_t bucket_cnt;                /* Number of buckets. */
+    char unused[NAME_MAX + 1 - sizeof (uint32_t)];
+    bool in_use;                        /* Always false. */
+    uint32_t split_cnt;                 /* Buckets split so far. */
+    uint8_t split[MAX_BUCKETS / 2 / CHAR_BIT]; /* Bit set if split. */
+  };
+
 /* Creates a directory with space for ENTRY_CNT entries in the
    given SECTOR.  Returns true if successful, false on failure. */
 bool
 dir_create (block_sector_t sector, size_t entry_cnt)
 {
-  return inode_create (sector, entry_cnt * sizeof (struct dir_entry));
+  return inode_create (sector, entry_cnt * sizeof (struct dir_entry), true);
+}
+
+/* Returns the most sectors that dir_add() changes through the
+   journal: every sector of a newly hashed directory, along with
+   its inode and extent tree, or one step of growth. */
+size_t
+dir_add_journal_max (void)
+{
+  size_t convert_max
+    = inode_journal_max ((CONVERT_BUCKETS + 1) * BLOCK_SECTOR_SIZE);
+
+  return convert_max > GROW_JOURNAL_MAX ? convert_max : GROW_JOURNAL_MAX;
+}
+
+/* Returns the most sectors that dir_remove() changes through the
+   journal: the sector that holds the entry, and the directory's
+   inode in case the entries are stored there. */
+size_t
+dir_remove_journal_max (void)
+{
+  return 2;
 }
 
 /* Opens and returns the directory for the given INODE, of which
@@ -39,6 +123,7 @@ dir_open (struct inode *inode)
     {
       dir->inode = inode;
       dir->pos = 0;
+      inode_set_journaled (inode);
       return dir;
     }
   else
@@ -83,6 +168,44 @@ dir_get_inode (struct dir *dir)
   return dir->inode;
 }
 
+/* Reads the header of DIR into *H.  Returns true if DIR is
+   hashed, false if it is linear. */
+static bool
+read_header (const struct dir *dir, struct dir_header *h)
+{
+  return (inode_read_at (dir->inode, h, sizeof *h, 0) == sizeof *h
+          && h->magic == DIR_HASH_MAGIC && !h->in_use);
+}
+
+/* Returns true if bucket B of the hashed directory with header
+   *H has been split in the doubling under way. */
+static inline bool
+is_split (const struct dir_header *h, size_t b)
+{
+  return b < h->bucket_cnt && (h->split[b / CHAR_BIT] >> b % CHAR_BIT) & 1;
+}
+
+/* Returns the byte offset of slot IDX within BUCKET of a hashed
+   directory. */
+static inline off_t
+slot_ofs (size_t bucket, size_t idx)
+{
+  return (bucket + 1) * BLOCK_SECTOR_SIZE + idx * sizeof (struct dir_entry);
+}
+
+/* Returns the bucket for NAME in the hashed directory with
+   header *H. */
+static inline size_t
+name_bucket (const char *name, const struct dir_header *h)
+{
+  unsigned hash = hash_string (name);
+  size_t bucket = hash % h->bucket_cnt;
+
+  if (is_split (h, bucket))
+    bucket = hash % (2 * h->bucket_cnt);
+  return bucket;
+}
+
 /* Searches DIR for a file with the given NAME.
    If successful, returns true, sets *EP to the directory entry
    if EP is non-null, and sets *OFSP to the byte offset of the
@@ -93,24 +216,264 @@ lookup (const struct dir *dir, const char *name,
         struct dir_entry *ep, off_t *ofsp) 
 {
   struct dir_entry e;
+  struct dir_header h;
+  size_t bucket, i;
   size_t ofs;
   
   ASSERT (dir != NULL);
   ASSERT (name != NULL);
 
-  for (ofs = 0; inode_read_at (dir->inode, &e, sizeof e, ofs) == sizeof e;
-       ofs += sizeof e) 
-    if (e.in_use && !strcmp (name, e.name)) 
-      {
-        if (ep != NULL)
+  if (!read_header (dir, &h))
+    {
+      /* Linear directory: scan every entry. */
+      for (ofs = 0; inode_read_at (dir->inode, &e, sizeof e, ofs) == sizeof e;
+           ofs += sizeof e) 
+        if (e.in_use && !strcmp (name, e.name)) 
+          goto found;
+      return false;
+    }
+
+  /* Hashed directory: scan NAME's bucket only. */
+  bucket = name_bucket (name, &h);
+  for (i = 0; i < BUCKET_ENTRIES; i++)
+    {
+      ofs = slot_ofs (bucket, i);
+      if (inode_read_at (dir->inode, &e, sizeof e, ofs) != sizeof e)
+        break;
+      if (e.in_use && !strcmp (name, e.name))
+        goto found;
+    }
+  return false;
+
+ found:
+  if (ep != NULL)
+    *ep = e;
+  if (ofsp != NULL)
+    *ofsp = ofs;
+  return true;
+}
+
+/* Reads the next directory entry in use in DIR into *EP.
+   Returns true if successful, false if the directory contains no
+   more entries.  DIR's inode must be locked. */
+static bool
+next_entry (struct dir *dir, struct dir_entry *ep)
+{
+  struct dir_entry e;
+  struct dir_header h;
+  bool hashed = read_header (dir, &h);
+
+  for (;;)
+    {
+      /* In a hashed directory, skip the header sector and the
+         unused space at the end of each bucket. */
+      if (hashed)
+        {
+          if (dir->pos < BLOCK_SECTOR_SIZE)
+            dir->pos = BLOCK_SECTOR_SIZE;
+          else if (dir->pos % BLOCK_SECTOR_SIZE
+                   >= (off_t) (BUCKET_ENTRIES * sizeof e))
+            dir->pos = ROUND_UP (dir->pos, BLOCK_SECTOR_SIZE);
+        }
+      if (inode_read_at (dir->inode, &e, sizeof e, dir->pos) != sizeof e)
+        break;
+      dir->pos += sizeof e;
+      if (e.in_use)
+        {
           *ep = e;
-        if (ofsp != NULL)
-          *ofsp = ofs;
-        return true;
-      }
+          return true;
+        } 
+    }
   return false;
 }
 
+/* An entry being moved to a new bucket. */
+struct rehash_entry
+  {
+    size_t bucket;                      /* Destination bucket. */
+    struct dir_entry e;                 /* The entry. */
+  };
+
+/* Orders rehash_entry structures by bucket, for qsort(). */
+static int
+compare_bucket (const void *a_, const void *b_)
+{
+  const struct rehash_entry *a = a_;
+  const struct rehash_entry *b = b_;
+
+  return a->bucket < b->bucket ? -1 : a->bucket > b->bucket;
+}
+
+/* Rewrites linear directory DIR as a hashed directory with at
+   least MIN_BUCKETS buckets, doubling the number of buckets until
+   every bucket has a free slot left.  Returns true if successful,
+   false if memory or disk space runs out or the directory would
+   need more than CONVERT_BUCKETS buckets.  DIR's inode must be
+   locked. */
+static bool
+convert (struct dir *dir)
+{
+  struct rehash_entry *entries = NULL;
+  struct dir_entry *sector = NULL;
+  struct dir_header *h;
+  struct dir dir_copy;
+  size_t entry_cnt = 0, capacity = 0;
+  size_t bucket_cnt, i, j;
+  bool success = false;
+  struct dir_entry e;
+
+  /* Collect the entries in use. */
+  dir_copy.inode = dir->inode;
+  dir_copy.pos = 0;
+  while (next_entry (&dir_copy, &e))
+    {
+      if (entry_cnt == capacity)
+        {
+          struct rehash_entry *p;
+          capacity = capacity ? 2 * capacity : LINEAR_MAX;
+          p = realloc (entries, capacity * sizeof *entries);
+          if (p == NULL)
+            goto done;
+          entries = p;
+        }
+      entries[entry_cnt++].e = e;
+    }
+
+  /* Pick a bucket count that leaves room in every bucket. */
+  for (bucket_cnt = MIN_BUCKETS; ; bucket_cnt *= 2)
+    {
+      if (bucket_cnt > CONVERT_BUCKETS)
+        goto done;
+      for (i = 0; i < entry_cnt; i++)
+        entries[i].bucket = hash_string (entries[i].e.name) % bucket_cnt;
+      qsort (entries, entry_cnt, sizeof *entries, compare_bucket);
+      for (i = 0; i + BUCKET_ENTRIES <= entry_cnt; i++)
+        if (entries[i].bucket == entries[i + BUCKET_ENTRIES - 1].bucket)
+          break;
+      if (i + BUCKET_ENTRIES > entry_cnt)
+        break;
+    }
+
+  /* Write out the buckets, then the header. */
+  sector = malloc (BLOCK_SECTOR_SIZE);
+  if (sector == NULL)
+    goto done;
+  for (i = j = 0; i < bucket_cnt; i++)
+    {
+      size_t k;
+
+      memset (sector, 0, BLOCK_SECTOR_SIZE);
+      for (k = 0; j < entry_cnt && entries[j].bucket == i; j++, k++)
+        sector[k] = entries[j].e;
+      if (inode_write_at (dir->inode, sector, BLOCK_SECTOR_SIZE,
+                          slot_ofs (i, 0)) != BLOCK_SECTOR_SIZE)
+        goto done;
+    }
+  memset (sector, 0, BLOCK_SECTOR_SIZE);
+  h = (struct dir_header *) sector;
+  h->magic = DIR_HASH_MAGIC;
+  h->bucket_cnt = bucket_cnt;
+  h->in_use = false;
+  success = inode_write_at (dir->inode, sector, BLOCK_SECTOR_SIZE, 0)
+            == BLOCK_SECTOR_SIZE;
+
+ done:
+  free (sector);
+  free (entries);
+  return success;
+}
+
+/* Splits bucket B of hashed directory DIR, whose header is *H,
+   moving the entries that belong in bucket B + H->BUCKET_CNT of
+   the doubled directory there.  Records the split in *H, and
+   finishes the doubling once every bucket has been split, but
+   does not write *H back.  Returns true if successful, false if
+   memory or disk space runs out.  DIR's inode must be locked. */
+static bool
+split_bucket (struct dir *dir, struct dir_header *h, size_t b)
+{
+  size_t new_b = b + h->bucket_cnt;
+  struct dir_entry *old, *new;
+  size_t i, k;
+  bool success = false;
+
+  ASSERT (!is_split (h, b));
+
+  old = malloc (2 * BLOCK_SECTOR_SIZE);
+  if (old == NULL)
+    return false;
+  new = (struct dir_entry *) ((char *) old + BLOCK_SECTOR_SIZE);
+  if (inode_read_at (dir->inode, old, BLOCK_SECTOR_SIZE, slot_ofs (b, 0))
+      != BLOCK_SECTOR_SIZE)
+    goto done;
+
+  /* Write the new bucket first, since only extending the
+     directory can fail. */
+  memset (new, 0, BLOCK_SECTOR_SIZE);
+  for (i = k = 0; i < BUCKET_ENTRIES; i++)
+    if (old[i].in_use
+        && hash_string (old[i].name) % (2 * h->bucket_cnt) == new_b)
+      {
+        new[k++] = old[i];
+        old[i].in_use = false;
+      }
+  if (k > 0
+      && (inode_write_at (dir->inode, new, BLOCK_SECTOR_SIZE,
+                          slot_ofs (new_b, 0)) != BLOCK_SECTOR_SIZE
+          || inode_write_at (dir->inode, old, BLOCK_SECTOR_SIZE,
+                             slot_ofs (b, 0)) != BLOCK_SECTOR_SIZE))
+    goto done;
+
+  h->split[b / CHAR_BIT] |= 1 << b % CHAR_BIT;
+  if (++h->split_cnt == h->bucket_cnt)
+    {
+      h->bucket_cnt *= 2;
+      h->split_cnt = 0;
+      memset (h->split, 0, sizeof h->split);
+    }
+  success = true;
+
+ done:
+  free (old);
+  return success;
+}
+
+/* Takes a step toward doubling the number of buckets in hashed
+   directory DIR, whose header is *H, because BUCKET is full:
+   splits BUCKET, unless it has been split already, and other
+   buckets, up to GROW_STEP in all, then writes *H back.  Returns
+   true if successful, false if DIR already has MAX_BUCKETS
+   buckets or memory or disk space runs out.  DIR's inode must be
+   locked. */
+static bool
+grow (struct dir *dir, struct dir_header *h, size_t bucket)
+{
+  size_t step = 0, b;
+  bool success = true;
+
+  if (h->split_cnt == 0 && h->bucket_cnt >= MAX_BUCKETS)
+    return false;
+
+  if (bucket < h->bucket_cnt && !is_split (h, bucket))
+    {
+      success = split_bucket (dir, h, bucket);
+      step++;
+    }
+  for (b = 0; success && step < GROW_STEP && h->split_cnt > 0
+              && b < h->bucket_cnt; b++)
+    if (!is_split (h, b))
+      {
+        success = split_bucket (dir, h, b);
+        step++;
+      }
+
+  /* Record the splits that were made even if one failed, since
+     their entries have already moved. */
+  if (inode_write_at (dir->inode, h, sizeof *h, 0) != sizeof *h)
+    success = false;
+  return success;
+}
+
 /* Searches DIR for a file with the given NAME
    and returns true if one exists, false otherwise.
    On success, sets *INODE to an inode for the file, otherwise to
@@ -119,15 +482,30 @@ bool
 dir_lookup (const struct dir *dir, const char *name,
             struct inode **inode) 
 {
+  block_sector_t dir_sector;
+  block_sector_t sector;
   struct dir_entry e;
 
   ASSERT (dir != NULL);
   ASSERT (name != NULL);
 
-  if (lookup (dir, name, &e, NULL))
-    *inode = inode_open (e.inode_sector);
+  /* Consult the dentry cache before reading the directory. */
+  inode_lock (dir->inode);
+  dir_sector = inode_get_inumber (dir->inode);
+  if (!dcache_lookup (dir_sector, name, &sector))
+    {
+      sector = lookup (dir, name, &e, NULL) ? e.inode_sector : DCACHE_NEGATIVE;
+      if (strlen (name) <= NAME_MAX)
+        dcache_insert (dir_sector, name, sector);
+    }
+
+  /* Open the inode before unlocking, so that the file cannot be
+     removed and its sector reused in between. */
+  if (sector != DCACHE_NEGATIVE)
+    *inode = inode_open (sector);
   else
     *inode = NULL;
+  inode_unlock (dir->inode);
 
   return *inode != NULL;
 }
@@ -141,8 +519,11 @@ dir_lookup (const struct dir *dir, const char *name,
 bool
 dir_add (struct dir *dir, const char *name, block_sector_t inode_sector)
 {
+  block_sector_t dir_sector = inode_get_inumber (dir->inode);
+  block_sector_t cached;
   struct dir_entry e;
   off_t ofs;
+  bool grown = false;
   bool success = false;
 
   ASSERT (dir != NULL);
@@ -152,29 +533,74 @@ dir_add (struct dir *dir, const char *name, block_sector_t inode_sector)
   if (*name == '\0' || strlen (name) > NAME_MAX)
     return false;
 
+  inode_lock (dir->inode);
+
   /* Check that NAME is not in use. */
-  if (lookup (dir, name, NULL, NULL))
+  if (dcache_lookup (dir_sector, name, &cached)
+      ? cached != DCACHE_NEGATIVE
+      : lookup (dir, name, NULL, NULL))
     goto done;
 
-  /* Set OFS to offset of free slot.
-     If there are no free slots, then it will be set to the
-     current end-of-file.
+  for (;;)
+    {
+      struct dir_header h;
+      size_t bucket, i;
+
+      if (!read_header (dir, &h))
+        {
+          /* Set OFS to offset of free slot.
+             If there are no free slots, then it will be set to the
+             current end-of-file.
      
-     inode_read_at() will only return a short read at end of file.
-     Otherwise, we'd need to verify that we didn't get a short
-     read due to something intermittent such as low memory. */
-  for (ofs = 0; inode_read_at (dir->inode, &e, sizeof e, ofs) == sizeof e;
-       ofs += sizeof e) 
-    if (!e.in_use)
-      break;
+             inode_read_at() will only return a short read at end of
+             file.  Otherwise, we'd need to verify that we didn't get a
+             short read due to something intermittent such as low
+             memory. */
+          for (ofs = 0;
+               inode_read_at (dir->inode, &e, sizeof e, ofs) == sizeof e;
+               ofs += sizeof e) 
+            if (!e.in_use)
+              break;
+          if (ofs < (off_t) (LINEAR_MAX * sizeof e))
+            break;
+
+          /* Too big to keep scanning linearly. */
+          if (!convert (dir))
+            goto done;
+          continue;
+        }
+
+      /* Find a free slot in NAME's bucket. */
+      bucket = name_bucket (name, &h);
+      for (i = 0; i < BUCKET_ENTRIES; i++)
+        {
+          ofs = slot_ofs (bucket, i);
+          if (inode_read_at (dir->inode, &e, sizeof e, ofs) != sizeof e
+              || !e.in_use)
+            break;
+        }
+      if (i < BUCKET_ENTRIES)
+        break;
+
+      /* Bucket full.  Grow only one step per call, which is all
+         that dir_add_journal_max() leaves room for. */
+      if (grown || !grow (dir, &h, bucket))
+        goto done;
+      grown = true;
+    }
 
   /* Write slot. */
   e.in_use = true;
   strlcpy (e.name, name, sizeof e.name);
   e.inode_sector = inode_sector;
   success = inode_write_at (dir->inode, &e, sizeof e, ofs) == sizeof e;
+  if (success)
+    dcache_insert (dir_sector, name, inode_sector);
+  else
+    dcache_invalidate (dir_sector, name);
 
  done:
+  inode_unlock (dir->inode);
   return success;
 }
 
@@ -192,6 +618,8 @@ dir_remove (struct dir *dir, const char *name)
   ASSERT (dir != NULL);
   ASSERT (name != NULL);
 
+  inode_lock (dir->inode);
+
   /* Find directory entry. */
   if (!lookup (dir, name, &e, &ofs))
     goto done;
@@ -211,6 +639,11 @@ dir_remove (struct dir *dir, const char *name)
   success = true;
 
  done:
+  if (success)
+    dcache_insert (inode_get_inumber (dir->inode), name, DCACHE_NEGATIVE);
+  else
+    dcache_invalidate (inode_get_inumber (dir->inode), name);
+  inode_unlock (dir->inode);
   inode_close (inode);
   return success;
 }
@@ -222,15 +655,61 @@ bool
 dir_readdir (struct dir *dir, char name[NAME_MAX + 1])
 {
   struct dir_entry e;
+  bool success;
 
-  while (inode_read_at (dir->inode, &e, sizeof e, dir->pos) == sizeof e) 
+  inode_lock (dir->inode);
+  success = next_entry (dir, &e);
+  inode_unlock (dir->inode);
+  if (success)
+    strlcpy (name, e.name, NAME_MAX + 1);
+  return success;
+}
+
+/* Reads up to CNT entries from DIR into ENTS, as dir_readdir()
+   would one at a time, but locking DIR only once.  If STAT is
+   true, also opens each entry's inode to fill in its size and
+   type.  Returns the number of entries read, which is less than
+   CNT only at the end of the directory. */
+size_t
+dir_readdir_batch (struct dir *dir, struct dirent *ents, size_t cnt,
+                   bool stat)
+{
+  struct dir_entry e;
+  size_t i;
+
+  inode_lock (dir->inode);
+  for (i = 0; i < cnt && next_entry (dir, &e); i++)
     {
-      dir->pos += sizeof e;
-      if (e.in_use)
+      struct dirent *d = &ents[i];
+      d->d_ino = e.inode_sector;
+      d->d_size = 0;
+      d->d_isdir = false;
+      strlcpy (d->d_name, e.name, sizeof d->d_name);
+      if (stat)
         {
-          strlcpy (name, e.name, NAME_MAX + 1);
-          return true;
-        } 
+          struct inode *inode = inode_open (e.inode_sector);
+          if (inode != NULL)
+            {
+              d->d_size = inode_length (inode);
+              d->d_isdir = inode_is_dir (inode);
+              inode_close (inode);
+            }
+        }
     }
-  return false;
+  inode_unlock (dir->inode);
+  return i;
+}
+
+/* Returns the current position of DIR, for dir_seek(). */
+off_t
+dir_tell (struct dir *dir) 
+{
+  return dir->pos;
+}
+
+/* Sets DIR's position to POS, as returned by dir_tell(). */
+void
+dir_seek (struct dir *dir, off_t pos) 
+{
+  dir->pos = pos;
 }
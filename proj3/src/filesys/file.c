@@ -1,7 +1,14 @@
 #include "filesys/file.h"
 #include <debug.h>
+#include "devices/block.h"
 #include "filesys/inode.h"
 #include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/vaddr.h"
+
+/* Bounds on the read-ahead window, in sectors. */
+#define READAHEAD_MIN 2
+#define READAHEAD_MAX 16
 
 /* An open file. */
 struct file 
@@ -9,8 +16,13 @@ struct file
     struct inode *inode;        /* File's inode. */
     off_t pos;                  /* Current position. */
     bool deny_write;            /* Has file_deny_write() been called? */
+    off_t ra_next;              /* Where a sequential read would start. */
+    off_t ra_end;               /* End of data already read ahead. */
+    int ra_window;              /* Read-ahead window in sectors, 0=off. */
   };
 
+static void readahead (struct file *, off_t ofs, off_t size);
+
 /* Opens a file for the given INODE, of which it takes ownership,
    and returns the new file.  Returns a null pointer if an
    allocation fails or if INODE is null. */
@@ -23,6 +35,9 @@ file_open (struct inode *inode)
       file->inode = inode;
       file->pos = 0;
       file->deny_write = false;
+      file->ra_next = 0;
+      file->ra_end = 0;
+      file->ra_window = 0;
       return file;
     }
   else
@@ -64,15 +79,71 @@ file_get_inode (struct file *file)
    starting at the file's current position.
    Returns the number of bytes actually read,
    which may be less than SIZE if end of file is reached.
-   Advances FILE's position by the number of bytes read. */
+   Advances FILE's position by the number of bytes read.
+   Sequential reads start reading ahead in the background. */
 off_t
 file_read (struct file *file, void *buffer, off_t size) 
 {
   off_t bytes_read = inode_read_at (file->inode, buffer, size, file->pos);
+  readahead (file, file->pos, bytes_read);
+  file->pos += bytes_read;
+  return bytes_read;
+}
+
+/* Reads from FILE into the IOV_CNT buffers in IOV, filling each
+   in turn, starting at the file's current position.
+   Returns the number of bytes actually read,
+   which may be less than the buffers' total size if end of file
+   is reached.
+   Advances FILE's position by the number of bytes read. */
+off_t
+file_readv (struct file *file, const struct iovec *iov, int iov_cnt) 
+{
+  off_t bytes_read = inode_readv (file->inode, iov, iov_cnt, file->pos);
+  readahead (file, file->pos, bytes_read);
   file->pos += bytes_read;
   return bytes_read;
 }
 
+/* Updates FILE's read-ahead state after a read of SIZE bytes at
+   OFS.  A read that picks up where the previous one left off
+   doubles the read-ahead window, up to READAHEAD_MAX sectors;
+   any other read turns read-ahead off until the access pattern
+   becomes sequential again.  Then queues whatever part of the
+   window past OFS + SIZE has not been read ahead already.  Reads
+   of INODE_DIRECT_MIN bytes or more go around the buffer cache,
+   so reading ahead into it would only cost them a copy. */
+static void
+readahead (struct file *file, off_t ofs, off_t size)
+{
+  off_t start, end;
+
+  if (ofs == file->ra_next)
+    {
+      file->ra_window *= 2;
+      if (file->ra_window < READAHEAD_MIN)
+        file->ra_window = READAHEAD_MIN;
+      if (file->ra_window > READAHEAD_MAX)
+        file->ra_window = READAHEAD_MAX;
+    }
+  else
+    {
+      file->ra_window = 0;
+      file->ra_end = 0;
+    }
+  file->ra_next = ofs + size;
+
+  if (file->ra_window == 0 || size == 0 || size >= INODE_DIRECT_MIN)
+    return;
+  start = file->ra_next > file->ra_end ? file->ra_next : file->ra_end;
+  end = file->ra_next + file->ra_window * BLOCK_SECTOR_SIZE;
+  if (start < end)
+    {
+      inode_readahead (file->inode, start, end - start);
+      file->ra_end = end;
+    }
+}
+
 /* Reads SIZE bytes from FILE into BUFFER,
    starting at offset FILE_OFS in the file.
    Returns the number of bytes actually read,
@@ -87,14 +158,37 @@ file_read_at (struct file *file, void *buffer, off_t size, off_t file_ofs)
 /* Writes SIZE bytes from BUFFER into FILE,
    starting at the file's current position.
    Returns the number of bytes actually written,
-   which may be less than SIZE if end of file is reached.
-   (Normally we'd grow the file in that case, but file growth is
-   not yet implemented.)
+   which may be less than SIZE if the disk is full.
+   Writing past end of file grows the file.
+   A directory cannot be written this way: nothing is written.
    Advances FILE's position by the number of bytes read. */
 off_t
 file_write (struct file *file, const void *buffer, off_t size) 
 {
-  off_t bytes_written = inode_write_at (file->inode, buffer, size, file->pos);
+  off_t bytes_written;
+
+  if (inode_is_dir (file->inode))
+    return 0;
+  bytes_written = inode_write_at (file->inode, buffer, size, file->pos);
+  file->pos += bytes_written;
+  return bytes_written;
+}
+
+/* Writes the IOV_CNT buffers in IOV, one after another, into
+   FILE, starting at the file's current position.
+   Returns the number of bytes actually written,
+   which may be less than the buffers' total size if the disk is
+   full.
+   Writing past end of file grows the file.
+   Advances FILE's position by the number of bytes written. */
+off_t
+file_writev (struct file *file, const struct iovec *iov, int iov_cnt) 
+{
+  off_t bytes_written;
+
+  if (inode_is_dir (file->inode))
+    return 0;
+  bytes_written = inode_writev (file->inode, iov, iov_cnt, file->pos);
   file->pos += bytes_written;
   return bytes_written;
 }
@@ -102,17 +196,58 @@ file_write (struct file *file, const void *buffer, off_t size)
 /* Writes SIZE bytes from BUFFER into FILE,
    starting at offset FILE_OFS in the file.
    Returns the number of bytes actually written,
-   which may be less than SIZE if end of file is reached.
-   (Normally we'd grow the file in that case, but file growth is
-   not yet implemented.)
+   which may be less than SIZE if the disk is full.
+   Writing past end of file grows the file.
+   A directory cannot be written this way: nothing is written.
    The file's current position is unaffected. */
 off_t
 file_write_at (struct file *file, const void *buffer, off_t size,
                off_t file_ofs) 
 {
+  if (inode_is_dir (file->inode))
+    return 0;
   return inode_write_at (file->inode, buffer, size, file_ofs);
 }
 
+/* Copies up to SIZE bytes from SRC, starting at its current
+   position, into DST at its current position, without passing
+   them through a caller-supplied buffer.  Returns the number of
+   bytes actually copied, which may be less than SIZE if end of
+   SRC is reached or the disk is full.
+   Advances both files' positions by the number of bytes copied. */
+off_t
+file_copy (struct file *dst, struct file *src, off_t size) 
+{
+  uint8_t *buffer;
+  off_t bytes_copied = 0;
+
+  if (inode_is_dir (dst->inode))
+    return 0;
+
+  /* Copying a page at a time keeps each read at least
+     INODE_DIRECT_MIN bytes long, so that uncached sectors are
+     read straight into BUFFER. */
+  buffer = palloc_get_page (0);
+  if (buffer == NULL)
+    return 0;
+  while (bytes_copied < size)
+    {
+      off_t chunk_size = size - bytes_copied < PGSIZE
+                         ? size - bytes_copied : PGSIZE;
+      off_t bytes_read = inode_read_at (src->inode, buffer, chunk_size,
+                                        src->pos);
+      off_t bytes_written = inode_write_at (dst->inode, buffer, bytes_read,
+                                            dst->pos);
+      src->pos += bytes_written;
+      dst->pos += bytes_written;
+      bytes_copied += bytes_written;
+      if (bytes_read < chunk_size || bytes_written < bytes_read)
+        break;
+    }
+  palloc_free_page (buffer);
+  return bytes_copied;
+}
+
 /* Prevents write operations on FILE's underlying inode
    until file_allow_write() is called or FILE is closed. */
 void
@@ -2,9 +2,12 @@
 #include <debug.h>
 #include <stdio.h>
 #include <string.h>
+#include "filesys/cache.h"
+#include "filesys/dcache.h"
 #include "filesys/file.h"
 #include "filesys/free-map.h"
 #include "filesys/inode.h"
+#include "filesys/journal.h"
 #include "filesys/directory.h"
 
 /* Partition that contains the file system. */
@@ -21,8 +24,9 @@ filesys_init (bool format)
   if (fs_device == NULL)
     PANIC ("No file system device found, can't initialize file system.");
 
-  lock_init (&fs_lock);
-
+  cache_init ();
+  journal_init (format);
+  dcache_init ();
   inode_init ();
   free_map_init ();
 
@@ -38,29 +42,39 @@ void
 filesys_done (void) 
 {
   free_map_close ();
+  journal_done ();
+  cache_done ();
 }
 
 /* Creates a file named NAME with the given INITIAL_SIZE.
    Returns true if successful, false otherwise.
    Fails if a file named NAME already exists,
-   or if internal memory allocation fails. */
+   or if internal memory allocation fails.
+   The new inode is placed near its directory's. */
 bool
 filesys_create (const char *name, off_t initial_size) 
 {
   block_sector_t inode_sector = 0;
-  struct dir *dir = dir_open_root ();
-  bool success = (dir != NULL
-                  && free_map_allocate (1, &inode_sector)
-                  && inode_create (inode_sector, initial_size)
-                  && dir_add (dir, name, inode_sector));
+  struct dir *dir;
+  bool success;
+
+  /* The new inode, and the directory entry. */
+  journal_begin (1 + dir_add_journal_max ());
+  dir = dir_open_root ();
+  success = (dir != NULL
+             && free_map_allocate (ROOT_DIR_SECTOR, 1, &inode_sector)
+             && inode_create (inode_sector, initial_size, false)
+             && dir_add (dir, name, inode_sector));
   if (!success && inode_sector != 0) 
     free_map_release (inode_sector, 1);
   dir_close (dir);
+  journal_end (1 + dir_add_journal_max ());
 
   return success;
 }
 
-/* Opens the file with the given NAME.
+/* Opens the file with the given NAME, or the root directory if
+   NAME is "/" or ".".
    Returns the new file if successful or a null pointer
    otherwise.
    Fails if no file named NAME exists,
@@ -72,7 +86,12 @@ filesys_open (const char *name)
   struct inode *inode = NULL;
 
   if (dir != NULL)
-    dir_lookup (dir, name, &inode);
+    {
+      if (!strcmp (name, "/") || !strcmp (name, "."))
+        inode = inode_reopen (dir_get_inode (dir));
+      else
+        dir_lookup (dir, name, &inode);
+    }
   dir_close (dir);
 
   return file_open (inode);
@@ -85,9 +104,14 @@ filesys_open (const char *name)
 bool
 filesys_remove (const char *name) 
 {
-  struct dir *dir = dir_open_root ();
-  bool success = dir != NULL && dir_remove (dir, name);
+  struct dir *dir;
+  bool success;
+
+  journal_begin (dir_remove_journal_max ());
+  dir = dir_open_root ();
+  success = dir != NULL && dir_remove (dir, name);
   dir_close (dir); 
+  journal_end (dir_remove_journal_max ());
 
   return success;
 }
@@ -3,7 +3,6 @@
 
 #include <stdbool.h>
 #include "filesys/off_t.h"
-#include "threads/synch.h"
 
 /* Sectors of system file inodes. */
 #define FREE_MAP_SECTOR 0       /* Free map file inode sector. */
@@ -12,9 +11,6 @@
 /* Block device that contains the file system. */
 struct block *fs_device;
 
-/* Owned by userprog/syscall. */
-struct lock fs_lock;
-
 void filesys_init (bool format);
 void filesys_done (void);
 bool filesys_create (const char *name, off_t initial_size);
@@ -1,52 +1,224 @@
 #include "filesys/free-map.h"
 #include <bitmap.h>
 #include <debug.h>
+#include <round.h>
 #include "filesys/file.h"
 #include "filesys/filesys.h"
 #include "filesys/inode.h"
+#include "filesys/journal.h"
+#include "threads/malloc.h"
+#include "threads/synch.h"
 
 static struct file *free_map_file;   /* Free map file. */
 static struct bitmap *free_map;      /* Free map, one bit per sector. */
+static struct lock free_map_lock;    /* Protects FREE_MAP. */
+static struct lock sync_lock;        /* Serializes writing FREE_MAP. */
+
+/* The disk is divided into allocation groups of GROUP_SECTORS
+   sectors.  Allocations are made near a caller-supplied goal
+   sector: first in the goal's group, then in the groups after
+   it.  Within a group, the search resumes where the group's last
+   allocation ended (next fit) rather than at the group's start. */
+#define GROUP_SECTORS 1024
+static size_t group_cnt;             /* Number of groups. */
+static block_sector_t *cursors;      /* Next-fit cursor per group. */
+
+/* Most sectors that writing the free map file changes through
+   the journal. */
+static size_t journal_max;
+
+/* Changes to the free map are not written to the free map file
+   as they are made.  Instead, free_map_sync() writes out the part
+   of the map that has changed, which each journal commit does,
+   along with free_map_close() at shutdown.  The changed part is
+   copied out under the free map lock and written after it is
+   released, because a write that reached a hole in the free map
+   file would need the lock again to allocate a sector. */
 
 /* Initializes the free map. */
 void
 free_map_init (void) 
 {
+  size_t i;
+
   free_map = bitmap_create (block_size (fs_device));
   if (free_map == NULL)
     PANIC ("bitmap creation failed--file system device is too large");
   bitmap_mark (free_map, FREE_MAP_SECTOR);
   bitmap_mark (free_map, ROOT_DIR_SECTOR);
+  bitmap_set_multiple (free_map, JOURNAL_SECTOR, JOURNAL_MAX + 1, true);
+  journal_max = inode_journal_max (bitmap_file_size (free_map));
+  if (journal_max > JOURNAL_MAX - JOURNAL_OP_MAX)
+    PANIC ("file system device is too large for the journal");
+  lock_init (&free_map_lock);
+  lock_init (&sync_lock);
+
+  group_cnt = DIV_ROUND_UP (bitmap_size (free_map), GROUP_SECTORS);
+  cursors = malloc (group_cnt * sizeof *cursors);
+  if (cursors == NULL)
+    PANIC ("can't allocate free map cursors");
+  for (i = 0; i < group_cnt; i++)
+    cursors[i] = i * GROUP_SECTORS;
 }
 
-/* Allocates CNT consecutive sectors from the free map and stores
-   the first into *SECTORP.
-   Returns true if successful, false if not enough consecutive
-   sectors were available or if the free_map file could not be
-   written. */
-bool
-free_map_allocate (size_t cnt, block_sector_t *sectorp)
+/* Returns the allocation group that contains SECTOR. */
+static inline size_t
+group_of (block_sector_t sector)
 {
-  block_sector_t sector = bitmap_scan_and_flip (free_map, 0, cnt, false);
-  if (sector != BITMAP_ERROR
-      && free_map_file != NULL
-      && !bitmap_write (free_map, free_map_file))
+  return sector / GROUP_SECTORS % group_cnt;
+}
+
+/* Finds CNT consecutive free sectors within group G, looking
+   first after the group's cursor and then before it, marks them
+   allocated, and returns the first.  Returns BITMAP_ERROR if the
+   group has no such run.  The free map lock must be held. */
+static size_t
+allocate_in_group (size_t g, size_t cnt)
+{
+  size_t start = g * GROUP_SECTORS;
+  size_t end = start + GROUP_SECTORS;
+  size_t sector;
+
+  if (end > bitmap_size (free_map))
+    end = bitmap_size (free_map);
+  if (cursors[g] >= end)
+    cursors[g] = start;
+
+  sector = bitmap_scan_range (free_map, cursors[g], end, cnt, false);
+  if (sector == BITMAP_ERROR && cursors[g] > start)
+    sector = bitmap_scan_range (free_map, start, cursors[g] + cnt - 1 < end
+                                ? cursors[g] + cnt - 1 : end, cnt, false);
+  if (sector != BITMAP_ERROR)
     {
-      bitmap_set_multiple (free_map, sector, cnt, false); 
-      sector = BITMAP_ERROR;
+      bitmap_set_multiple (free_map, sector, cnt, true);
+      cursors[g] = sector + cnt;
     }
+  return sector;
+}
+
+/* Allocates CNT consecutive free sectors in the group of GOAL or
+   the closest group after it that has room, and returns the
+   first.  Returns BITMAP_ERROR if no group has room.  The free
+   map lock must be held. */
+static size_t
+allocate_near (block_sector_t goal, size_t cnt)
+{
+  size_t first = group_of (goal);
+  size_t i;
+
+  for (i = 0; i < group_cnt; i++)
+    {
+      size_t sector = allocate_in_group ((first + i) % group_cnt, cnt);
+      if (sector != BITMAP_ERROR)
+        return sector;
+    }
+  return BITMAP_ERROR;
+}
+
+/* Allocates CNT consecutive sectors from the free map, as close
+   after GOAL as possible, and stores the first into *SECTORP.
+   Returns true if successful, false if not enough consecutive
+   sectors were available. */
+bool
+free_map_allocate (block_sector_t goal, size_t cnt, block_sector_t *sectorp)
+{
+  size_t sector;
+
+  lock_acquire (&free_map_lock);
+  sector = allocate_near (goal, cnt);
+  lock_release (&free_map_lock);
   if (sector != BITMAP_ERROR)
     *sectorp = sector;
   return sector != BITMAP_ERROR;
 }
 
+/* Allocates a run of up to CNT consecutive sectors, preferring
+   one that starts at GOAL so that a file's sectors stay
+   contiguous, then one in GOAL's allocation group, and stores
+   the first into *SECTORP.  If no run of CNT sectors is free,
+   settles for a shorter one.
+   Returns the number of sectors allocated, which is 0 only if
+   the disk is full. */
+size_t
+free_map_allocate_run (block_sector_t goal, size_t cnt,
+                       block_sector_t *sectorp)
+{
+  size_t sector = BITMAP_ERROR;
+  size_t got = 0;
+
+  ASSERT (cnt > 0);
+
+  lock_acquire (&free_map_lock);
+
+  /* Extend the run that ends just before GOAL, if possible. */
+  if (goal != 0 && goal < bitmap_size (free_map))
+    {
+      while (got < cnt && goal + got < bitmap_size (free_map)
+             && !bitmap_test (free_map, goal + got))
+        got++;
+      if (got > 0)
+        {
+          sector = goal;
+          bitmap_set_multiple (free_map, sector, got, true);
+          cursors[group_of (goal)] = goal + got;
+        }
+    }
+
+  /* Otherwise take a run near GOAL, halving the request until
+     something fits. */
+  for (; got == 0 && cnt > 0; cnt /= 2)
+    {
+      sector = allocate_near (goal, cnt);
+      if (sector != BITMAP_ERROR)
+        got = cnt;
+    }
+
+  lock_release (&free_map_lock);
+  if (got > 0)
+    *sectorp = sector;
+  return got;
+}
+
 /* Makes CNT sectors starting at SECTOR available for use. */
 void
 free_map_release (block_sector_t sector, size_t cnt)
 {
+  lock_acquire (&free_map_lock);
   ASSERT (bitmap_all (free_map, sector, cnt));
   bitmap_set_multiple (free_map, sector, cnt, false);
-  bitmap_write (free_map, free_map_file);
+  lock_release (&free_map_lock);
+}
+
+/* Writes the parts of the free map that have changed since it
+   was last written to the free map file. */
+void
+free_map_sync (void) 
+{
+  void *buf = NULL;
+  size_t ofs, size;
+
+  lock_acquire (&sync_lock);
+  lock_acquire (&free_map_lock);
+  if (free_map_file != NULL
+      && !bitmap_copy_dirty (free_map, &buf, &ofs, &size))
+    PANIC ("can't write free map");
+  lock_release (&free_map_lock);
+
+  if (buf != NULL)
+    {
+      if (file_write_at (free_map_file, buf, size, ofs) != (off_t) size)
+        PANIC ("can't write free map");
+      free (buf);
+    }
+  lock_release (&sync_lock);
+}
+
+/* Returns the most sectors that free_map_sync() can change
+   through the journal, which the journal keeps room for. */
+size_t
+free_map_journal_max (void)
+{
+  return journal_max;
 }
 
 /* Opens the free map file and reads it from disk. */
@@ -56,6 +228,7 @@ free_map_open (void)
   free_map_file = file_open (inode_open (FREE_MAP_SECTOR));
   if (free_map_file == NULL)
     PANIC ("can't open free map");
+  inode_set_journaled (file_get_inode (free_map_file));
   if (!bitmap_read (free_map, free_map_file))
     PANIC ("can't read free map");
 }
@@ -64,7 +237,13 @@ free_map_open (void)
 void
 free_map_close (void) 
 {
+  free_map_sync ();
+  lock_acquire (&sync_lock);
+  lock_acquire (&free_map_lock);
   file_close (free_map_file);
+  free_map_file = NULL;
+  lock_release (&free_map_lock);
+  lock_release (&sync_lock);
 }
 
 /* Creates a new free map file on disk and writes the free map to
@@ -73,13 +252,14 @@ void
 free_map_create (void) 
 {
   /* Create inode. */
-  if (!inode_create (FREE_MAP_SECTOR, bitmap_file_size (free_map)))
+  if (!inode_create (FREE_MAP_SECTOR, bitmap_file_size (free_map), false))
     PANIC ("free map creation failed");
 
   /* Write bitmap to file. */
   free_map_file = file_open (inode_open (FREE_MAP_SECTOR));
   if (free_map_file == NULL)
     PANIC ("can't open free map");
+  inode_set_journaled (file_get_inode (free_map_file));
   if (!bitmap_write (free_map, free_map_file))
     PANIC ("can't write free map");
 }
@@ -1,23 +1,99 @@
 #include "filesys/inode.h"
-#include <list.h>
+#include <hash.h>
 #include <debug.h>
+#include <iovec.h>
 #include <round.h>
+#include <stddef.h>
+#include <stdio.h>
 #include <string.h>
+#include "filesys/cache.h"
 #include "filesys/filesys.h"
 #include "filesys/free-map.h"
+#include "filesys/journal.h"
 #include "threads/malloc.h"
+#include "threads/synch.h"
 
 /* Identifies an inode. */
 #define INODE_MAGIC 0x494e4f44
 
+/* A run of LENGTH consecutive disk sectors, starting at START,
+   that holds file sectors OFFSET through OFFSET + LENGTH - 1. */
+struct extent
+  {
+    uint32_t offset;                    /* First file sector. */
+    block_sector_t start;               /* First disk sector. */
+    uint32_t length;                    /* Number of sectors. */
+  };
+
+/* Number of extents kept in the inode itself, in one leaf of the
+   extent tree, and number of leaves the tree's root can index. */
+#define INODE_EXTENTS 41
+#define LEAF_EXTENTS (BLOCK_SECTOR_SIZE / sizeof (struct extent))
+#define ROOT_LEAVES ((BLOCK_SECTOR_SIZE - sizeof (uint32_t)) \
+                     / (sizeof (uint16_t) + sizeof (block_sector_t)))
+
+/* Root sector of an extent tree.  Leaves are kept in file order.
+   Leaf I holds the tree's extents from FIRSTS[I] up to the first
+   extent of leaf I + 1, or to the end of the tree for the last
+   leaf, at the start of the leaf sector. */
+struct extent_root
+  {
+    uint32_t leaf_cnt;                  /* Number of leaves. */
+    uint16_t firsts[ROOT_LEAVES];       /* Index of each leaf's first extent. */
+    block_sector_t leaves[ROOT_LEAVES]; /* Leaf sectors. */
+  };
+
+/* Most sectors to ask the free map for at once when growing a
+   file. */
+#define MAX_RUN 64
+
+/* Most runs of sectors to allocate in one journaled operation
+   that extends a regular file, and the most sectors that such an
+   operation changes through the journal: the inode, the extent
+   tree root, and for each run the leaf it goes into and one new
+   leaf if that leaf has to split. */
+#define EXTEND_RUNS 8
+#define EXTEND_JOURNAL_MAX (2 + 2 * EXTEND_RUNS)
+
+/* Most bytes of data that an inode can hold itself. */
+#define INLINE_MAX (INODE_EXTENTS * sizeof (struct extent))
+
+/* Inode flags. */
+#define INODE_INLINE 0x1                /* Data is in INLINE_DATA. */
+#define INODE_DIR 0x2                   /* Inode is a directory. */
+
 /* On-disk inode.
-   Must be exactly BLOCK_SECTOR_SIZE bytes long. */
+   Must be exactly BLOCK_SECTOR_SIZE bytes long.
+
+   File data is described by a list of EXTENT_CNT extents sorted
+   by file offset.  File sectors not covered by any extent, which
+   need not be at the end of the file, are holes: they read as
+   zeros and get disk sectors only when first written.  The first
+   INODE_EXTENTS extents are stored here.  The
+   rest overflow into a two-level extent tree: TREE is a root
+   sector, a struct extent_root, that points to leaf sectors of
+   up to LEAF_EXTENTS extents each, or 0 if the file has no tree.
+   Leaves need not be full, so that inserting an extent only has
+   to shift the extents of one leaf, splitting it in two if it is
+   full; one insert thus changes the root and at most two leaves.
+
+   A file of at most INLINE_MAX bytes keeps its data in the inode
+   itself, in place of the extents, so that reading it takes no
+   sector beyond the inode's.  Such a file has the INODE_INLINE
+   flag set and no extents.  It moves to a data sector when it
+   grows past INLINE_MAX. */
 struct inode_disk
   {
-    block_sector_t start;               /* First data sector. */
     off_t length;                       /* File size in bytes. */
     unsigned magic;                     /* Magic number. */
-    uint32_t unused[125];               /* Not used. */
+    uint32_t extent_cnt;                /* Number of extents. */
+    block_sector_t tree;                /* Extent tree root, or 0. */
+    union
+      {
+        struct extent extents[INODE_EXTENTS]; /* First extents. */
+        uint8_t inline_data[INLINE_MAX]; /* Data of small file. */
+      };
+    uint32_t flags;                     /* INODE_* flags. */
   };
 
 /* Returns the number of sectors to allocate for an inode SIZE
@@ -28,49 +104,609 @@ bytes_to_sectors (off_t size)
   return DIV_ROUND_UP (size, BLOCK_SECTOR_SIZE);
 }
 
-/* In-memory inode. */
+/* Returns the largest number of extent tree sectors, root
+   included, that a file with EXTENT_CNT extents can need.  Every
+   leaf but the last is at least half full. */
+static inline size_t
+tree_sectors (size_t extent_cnt)
+{
+  if (extent_cnt <= INODE_EXTENTS)
+    return 0;
+  return 2 + (extent_cnt - INODE_EXTENTS) / (LEAF_EXTENTS / 2);
+}
+
+/* In-memory inode.
+
+   ELEM, OPEN_CNT, REMOVED and LOADING are protected by
+   OPEN_INODES_LOCK.
+   DATA, DENY_WRITE_CNT and the file's contents are protected by
+   RW: reading the file needs it for reading, and changing the
+   file's length, its extents, or DENY_WRITE_CNT needs it for
+   writing.  Writes to sectors that are already allocated hold RW
+   only for reading, relying on the buffer cache to keep each
+   sector consistent.  While LOADING is true, the opener that
+   created the inode holds RW for writing as it reads DATA from
+   disk.  HINT is only a guess, so it is read and written without
+   locking. */
 struct inode 
   {
-    struct list_elem elem;              /* Element in inode list. */
+    struct hash_elem elem;              /* Element in open_inodes. */
     block_sector_t sector;              /* Sector number of disk location. */
     int open_cnt;                       /* Number of openers. */
     bool removed;                       /* True if deleted, false otherwise. */
+    bool loading;                       /* DATA not yet read from disk? */
     int deny_write_cnt;                 /* 0: writes ok, >0: deny writes. */
+    size_t hint;                        /* Index of last extent used. */
+    bool journaled;                     /* Journal data writes? */
+    struct rwlock rw;                   /* Protects DATA and contents. */
+    struct lock dir_lock;               /* Serializes directory changes. */
     struct inode_disk data;             /* Inode content. */
   };
 
+/* Allocates a sector near GOAL, fills it with zeros, and stores
+   its number in *SECTORP.  Returns true if successful, false if
+   the disk is full. */
+static bool
+allocate_zeroed (block_sector_t goal, block_sector_t *sectorp)
+{
+  static char zeros[BLOCK_SECTOR_SIZE];
+
+  if (!free_map_allocate (goal, 1, sectorp))
+    return false;
+  journal_write (*sectorp, zeros);
+  return true;
+}
+
+/* Reads SIZE bytes at offset OFS of the extent tree root of
+   DISK into BUFFER. */
+static inline void
+read_root (struct inode_disk *disk, void *buffer, size_t ofs, size_t size)
+{
+  cache_read_at (disk->tree, buffer, ofs, size);
+}
+
+/* Finds extent T of the extent tree of DISK, which must exist.
+   Stores the sector of the leaf that holds it in *LEAF and the
+   byte offset of the extent within the leaf in *OFS. */
+static void
+locate_extent (struct inode_disk *disk, size_t t,
+               block_sector_t *leaf, off_t *ofs)
+{
+  uint32_t leaf_cnt;
+  uint16_t first;
+  size_t lo, hi;
+
+  /* Find the last leaf whose first extent is at most T. */
+  read_root (disk, &leaf_cnt, offsetof (struct extent_root, leaf_cnt),
+             sizeof leaf_cnt);
+  ASSERT (leaf_cnt > 0);
+  lo = 0;
+  hi = leaf_cnt;
+  while (hi - lo > 1)
+    {
+      size_t mid = lo + (hi - lo) / 2;
+      read_root (disk, &first, offsetof (struct extent_root, firsts[mid]),
+                 sizeof first);
+      if (first <= t)
+        lo = mid;
+      else
+        hi = mid;
+    }
+  read_root (disk, &first, offsetof (struct extent_root, firsts[lo]),
+             sizeof first);
+  read_root (disk, leaf, offsetof (struct extent_root, leaves[lo]),
+             sizeof *leaf);
+  *ofs = (t - first) * sizeof (struct extent);
+}
+
+/* Reads extent IDX of the file described by DISK into *E. */
+static void
+get_extent (struct inode_disk *disk, size_t idx, struct extent *e)
+{
+  block_sector_t leaf;
+  off_t ofs;
+
+  ASSERT (idx < disk->extent_cnt);
+
+  if (idx < INODE_EXTENTS)
+    *e = disk->extents[idx];
+  else
+    {
+      locate_extent (disk, idx - INODE_EXTENTS, &leaf, &ofs);
+      cache_read_at (leaf, e, ofs, sizeof *e);
+    }
+}
+
+/* Buffers for inserting into an extent tree, too big for the
+   stack. */
+struct insert_bufs
+  {
+    struct extent_root root;
+    struct extent leaf[LEAF_EXTENTS];
+    struct extent split[LEAF_EXTENTS];
+  };
+
+/* Inserts *E as extent T of the extent tree of DISK, which holds
+   TREE_CNT extents, allocating the root if there is none yet.
+   Writes the root and the one or two leaves that change through
+   the journal, but does not change DISK's extent count.
+   Returns false, changing nothing, if the tree is full or a
+   sector or memory cannot be allocated. */
+static bool
+tree_insert (struct inode_disk *disk, size_t t, size_t tree_cnt,
+             const struct extent *e)
+{
+  block_sector_t goal = disk->extents[INODE_EXTENTS - 1].start;
+  struct insert_bufs *ti;
+  struct extent_root *root;
+  struct extent *leaf;
+  size_t i, j, cnt, slot;
+  bool new_root = disk->tree == 0;
+
+  ASSERT (t <= tree_cnt);
+
+  ti = malloc (sizeof *ti);
+  if (ti == NULL)
+    return false;
+  root = &ti->root;
+  if (new_root)
+    {
+      if (!allocate_zeroed (goal, &disk->tree))
+        goto fail;
+      memset (root, 0, sizeof *root);
+    }
+  else
+    read_root (disk, root, 0, sizeof *root);
+
+  /* Find the last leaf whose first extent is at most T. */
+  for (i = root->leaf_cnt; i > 0 && root->firsts[i - 1] > t; i--)
+    continue;
+  if (i > 0)
+    i--;
+  cnt = (i + 1 < root->leaf_cnt ? root->firsts[i + 1] : tree_cnt)
+        - (root->leaf_cnt > 0 ? root->firsts[i] : 0);
+
+  if (root->leaf_cnt == 0 || cnt == LEAF_EXTENTS)
+    {
+      /* Start a new leaf.  Appending to a full last leaf starts an
+         empty one after it, keeping a file that grows at its end
+         in full leaves; otherwise the upper half of leaf I moves to
+         the new leaf. */
+      block_sector_t sector;
+      size_t moved = t == tree_cnt ? 0 : LEAF_EXTENTS / 2;
+
+      if (root->leaf_cnt == ROOT_LEAVES || !allocate_zeroed (goal, &sector))
+        goto fail;
+      if (root->leaf_cnt == 0)
+        {
+          root->leaves[0] = sector;
+          root->leaf_cnt = 1;
+          cnt = 0;
+        }
+      else
+        {
+          cache_read_at (root->leaves[i], ti->leaf, 0, sizeof ti->leaf);
+          memcpy (ti->split, ti->leaf + (cnt - moved),
+                  moved * sizeof *ti->split);
+          journal_write_at (sector, ti->split, 0, sizeof ti->split);
+          for (j = root->leaf_cnt; j > i + 1; j--)
+            {
+              root->firsts[j] = root->firsts[j - 1];
+              root->leaves[j] = root->leaves[j - 1];
+            }
+          root->firsts[i + 1] = root->firsts[i] + (cnt - moved);
+          root->leaves[i + 1] = sector;
+          root->leaf_cnt++;
+          if (t >= root->firsts[i + 1])
+            {
+              i++;
+              cnt = moved;
+            }
+          else
+            cnt -= moved;
+        }
+    }
+
+  /* Shift the rest of leaf I up to make room for *E. */
+  leaf = ti->leaf;
+  cache_read_at (root->leaves[i], leaf, 0, sizeof ti->leaf);
+  slot = t - root->firsts[i];
+  memmove (leaf + slot + 1, leaf + slot, (cnt - slot) * sizeof *leaf);
+  leaf[slot] = *e;
+  journal_write_at (root->leaves[i], leaf, 0, sizeof ti->leaf);
+  for (j = i + 1; j < root->leaf_cnt; j++)
+    root->firsts[j]++;
+  journal_write_at (disk->tree, root, 0, sizeof *root);
+  free (ti);
+  return true;
+
+ fail:
+  if (new_root && disk->tree != 0)
+    {
+      free_map_release (disk->tree, 1);
+      disk->tree = 0;
+    }
+  free (ti);
+  return false;
+}
+
+/* Inserts *E as extent IDX of the file described by DISK,
+   moving the extents from IDX on up by one.  Extents stored in
+   DISK itself are not written back.  Returns false if the extent
+   tree is full or a tree sector cannot be allocated. */
+static bool
+insert_extent (struct inode_disk *disk, size_t idx, const struct extent *e)
+{
+  size_t tree_cnt = (disk->extent_cnt > INODE_EXTENTS
+                     ? disk->extent_cnt - INODE_EXTENTS : 0);
+  size_t shift_cnt;
+
+  ASSERT (idx <= disk->extent_cnt);
+
+  if (idx >= INODE_EXTENTS)
+    {
+      if (!tree_insert (disk, idx - INODE_EXTENTS, tree_cnt, e))
+        return false;
+    }
+  else
+    {
+      /* The last extent in DISK itself moves to the front of the
+         tree first, since that is the only step that can fail. */
+      if (disk->extent_cnt >= INODE_EXTENTS
+          && !tree_insert (disk, 0, tree_cnt,
+                           &disk->extents[INODE_EXTENTS - 1]))
+        return false;
+      shift_cnt = (disk->extent_cnt < INODE_EXTENTS - 1
+                   ? disk->extent_cnt : INODE_EXTENTS - 1) - idx;
+      memmove (&disk->extents[idx + 1], &disk->extents[idx],
+               shift_cnt * sizeof *e);
+      disk->extents[idx] = *e;
+    }
+  disk->extent_cnt++;
+  return true;
+}
+
+/* Stores *E as extent IDX of the file described by DISK, which
+   may be one past its last extent.  Extents stored in DISK
+   itself are not written back.  Returns false if the extent
+   tree is full or a tree sector cannot be allocated. */
+static bool
+put_extent (struct inode_disk *disk, size_t idx, const struct extent *e)
+{
+  block_sector_t leaf;
+  off_t ofs;
+
+  ASSERT (idx <= disk->extent_cnt);
+
+  if (idx == disk->extent_cnt)
+    return insert_extent (disk, idx, e);
+  if (idx < INODE_EXTENTS)
+    disk->extents[idx] = *e;
+  else
+    {
+      locate_extent (disk, idx - INODE_EXTENTS, &leaf, &ofs);
+      journal_write_at (leaf, e, ofs, sizeof *e);
+    }
+  return true;
+}
+
+/* Returns the number of extents in DISK whose file offset is at
+   most SECTOR, which is also the index at which an extent for
+   SECTOR would be inserted. */
+static size_t
+extent_after (struct inode_disk *disk, uint32_t sector)
+{
+  struct extent e;
+  size_t lo = 0, hi = disk->extent_cnt;
+
+  while (lo < hi)
+    {
+      size_t mid = lo + (hi - lo) / 2;
+      get_extent (disk, mid, &e);
+      if (e.offset <= sector)
+        lo = mid + 1;
+      else
+        hi = mid;
+    }
+  return lo;
+}
+
+/* Returns the disk sector that holds file sector SECTOR of
+   INODE, or 0 if SECTOR is a hole.  Tries the extent used
+   last and the one after it before falling back to a binary
+   search. */
+static block_sector_t
+lookup_sector (struct inode *inode, uint32_t sector)
+{
+  struct inode_disk *disk = &inode->data;
+  struct extent e;
+  size_t lo;
+
+  if (disk->extent_cnt == 0)
+    return 0;
+
+  /* Sequential access usually stays in the same extent or moves
+     to the next one. */
+  for (lo = inode->hint; lo < disk->extent_cnt && lo < inode->hint + 2; lo++)
+    {
+      get_extent (disk, lo, &e);
+      if (sector < e.offset)
+        break;
+      if (sector < e.offset + e.length)
+        {
+          inode->hint = lo;
+          return e.start + (sector - e.offset);
+        }
+    }
+
+  /* Find the last extent whose offset is at most SECTOR. */
+  lo = extent_after (disk, sector);
+  if (lo == 0)
+    return 0;
+  get_extent (disk, --lo, &e);
+  if (sector >= e.offset + e.length)
+    return 0;
+  inode->hint = lo;
+  return e.start + (sector - e.offset);
+}
+
+/* Allocates disk sectors for the holes among the sectors of
+   INODE that hold the SIZE bytes starting at OFFSET, preferring
+   sectors that continue the extent before each hole, or that
+   follow the inode for a hole at the start of the file, so that
+   the file stays contiguous on disk.  New sectors are zeroed,
+   through the journal if INODE is journaled, except for those
+   that the SIZE bytes cover entirely, since the caller is about
+   to overwrite them.  Allocates at most MAX_RUNS runs of
+   sectors.  Does not change INODE's length.
+   Returns the number of bytes, up to SIZE, for which sectors are
+   now allocated; this is less than SIZE only if the disk or the
+   extent tree is full or MAX_RUNS runs were allocated. */
+static off_t
+map_range (struct inode *inode, off_t offset, off_t size, size_t max_runs)
+{
+  static char zeros[BLOCK_SECTOR_SIZE];
+  struct inode_disk *disk = &inode->data;
+  uint32_t sector = offset / BLOCK_SECTOR_SIZE;
+  uint32_t end = bytes_to_sectors (offset + size);
+  size_t run_cnt = 0;
+
+  if (size <= 0)
+    return 0;
+
+  while (sector < end && run_cnt < max_runs)
+    {
+      struct extent prev, next, e;
+      block_sector_t goal = inode->sector + 1, start;
+      uint32_t hole_end = end;
+      size_t idx, cnt, i;
+
+      if (lookup_sector (inode, sector) != 0)
+        {
+          sector++;
+          continue;
+        }
+
+      /* The hole runs up to the next extent. */
+      idx = extent_after (disk, sector);
+      if (idx > 0)
+        {
+          get_extent (disk, idx - 1, &prev);
+          goal = prev.start + (sector - prev.offset);
+        }
+      if (idx < disk->extent_cnt)
+        {
+          get_extent (disk, idx, &next);
+          if (next.offset < hole_end)
+            hole_end = next.offset;
+        }
+
+      cnt = free_map_allocate_run (goal, hole_end - sector < MAX_RUN
+                                   ? hole_end - sector : MAX_RUN, &start);
+      if (cnt == 0)
+        break;
+      run_cnt++;
+      for (i = 0; i < cnt; i++)
+        {
+          off_t sector_pos = (off_t) (sector + i) * BLOCK_SECTOR_SIZE;
+          if (sector_pos >= offset
+              && sector_pos + BLOCK_SECTOR_SIZE <= offset + size)
+            continue;
+          if (inode->journaled)
+            journal_write (start + i, zeros);
+          else
+            cache_write (start + i, zeros);
+        }
+
+      /* Grow a neighboring extent if the new sectors continue it
+         on disk, otherwise add an extent. */
+      if (idx > 0 && prev.offset + prev.length == sector
+          && prev.start + prev.length == start)
+        {
+          prev.length += cnt;
+          put_extent (disk, idx - 1, &prev);
+        }
+      else if (idx < disk->extent_cnt && next.offset == sector + cnt
+               && next.start == start + cnt)
+        {
+          next.offset = sector;
+          next.start = start;
+          next.length += cnt;
+          put_extent (disk, idx, &next);
+        }
+      else
+        {
+          e.offset = sector;
+          e.start = start;
+          e.length = cnt;
+          if (!insert_extent (disk, idx, &e))
+            {
+              free_map_release (start, cnt);
+              break;
+            }
+        }
+      sector += cnt;
+    }
+
+  if (sector >= end)
+    return size;
+  else if ((off_t) sector * BLOCK_SECTOR_SIZE > offset)
+    return (off_t) sector * BLOCK_SECTOR_SIZE - offset;
+  else
+    return 0;
+}
+
+/* Returns true if INODE has disk sectors allocated for all of the
+   SIZE bytes starting at OFFSET, all of which are within the
+   file.  Always false for an inode with inline data, since
+   writing it changes the inode. */
+static bool
+is_mapped (struct inode *inode, off_t offset, off_t size)
+{
+  off_t pos;
+
+  if (offset + size > inode->data.length
+      || inode->data.flags & INODE_INLINE)
+    return false;
+  for (pos = ROUND_DOWN (offset, BLOCK_SECTOR_SIZE); pos < offset + size;
+       pos += BLOCK_SECTOR_SIZE)
+    if (lookup_sector (inode, pos / BLOCK_SECTOR_SIZE) == 0)
+      return false;
+  return true;
+}
+
+/* Moves the inline data of INODE into a newly allocated data
+   sector.  The data of a journaled inode goes through the journal
+   along with the inode.  Otherwise it is written to disk before
+   returning, so that it is there before the inode change that
+   refers to it commits; data sectors never go through the
+   journal, whose replay would bring back stale contents.
+   Returns true if successful, false if the disk is full. */
+static bool
+move_inline (struct inode *inode)
+{
+  static char zeros[BLOCK_SECTOR_SIZE];
+  struct inode_disk *disk = &inode->data;
+  struct extent e;
+
+  ASSERT (disk->flags & INODE_INLINE);
+
+  e.length = 0;
+  if (disk->length > 0)
+    {
+      if (!free_map_allocate (inode->sector + 1, 1, &e.start))
+        return false;
+      if (inode->journaled)
+        {
+          journal_write (e.start, zeros);
+          journal_write_at (e.start, disk->inline_data, 0, disk->length);
+        }
+      else
+        {
+          cache_write (e.start, zeros);
+          cache_write_at (e.start, disk->inline_data, 0, disk->length);
+          cache_sync (e.start);
+        }
+      e.offset = 0;
+      e.length = 1;
+    }
+
+  disk->flags &= ~INODE_INLINE;
+  memset (disk->extents, 0, sizeof disk->extents);
+  if (e.length > 0)
+    put_extent (disk, 0, &e);
+  return true;
+}
+
+/* Frees all of the data and extent tree sectors of the file
+   described by DISK. */
+static void
+release_sectors (struct inode_disk *disk)
+{
+  struct extent e;
+  block_sector_t leaf;
+  uint32_t leaf_cnt;
+  size_t i;
+
+  for (i = 0; i < disk->extent_cnt; i++)
+    {
+      get_extent (disk, i, &e);
+      free_map_release (e.start, e.length);
+    }
+  if (disk->tree != 0)
+    {
+      read_root (disk, &leaf_cnt, offsetof (struct extent_root, leaf_cnt),
+                 sizeof leaf_cnt);
+      for (i = 0; i < leaf_cnt; i++)
+        {
+          read_root (disk, &leaf, offsetof (struct extent_root, leaves[i]),
+                     sizeof leaf);
+          free_map_release (leaf, 1);
+        }
+      free_map_release (disk->tree, 1);
+    }
+}
+
 /* Returns the block device sector that contains byte offset POS
    within INODE.
    Returns -1 if INODE does not contain data for a byte at offset
-   POS. */
+   POS, or 0 if that byte lies in a hole. */
 static block_sector_t
-byte_to_sector (const struct inode *inode, off_t pos) 
+byte_to_sector (struct inode *inode, off_t pos) 
 {
   ASSERT (inode != NULL);
   if (pos < inode->data.length)
-    return inode->data.start + pos / BLOCK_SECTOR_SIZE;
+    return lookup_sector (inode, pos / BLOCK_SECTOR_SIZE);
   else
     return -1;
 }
 
-/* List of open inodes, so that opening a single inode twice
-   returns the same `struct inode'. */
-static struct list open_inodes;
+/* Open inodes, keyed by sector, so that opening a single inode
+   twice returns the same `struct inode'. */
+static struct hash open_inodes;
+static struct lock open_inodes_lock;
+
+/* Largest number of inodes open at once. */
+static size_t peak_open_cnt;
+
+static hash_hash_func inode_hash;
+static hash_less_func inode_less;
 
 /* Initializes the inode module. */
 void
 inode_init (void) 
 {
-  list_init (&open_inodes);
+  if (!hash_init (&open_inodes, inode_hash, inode_less, NULL))
+    PANIC ("out of memory for open inode table");
+  lock_init (&open_inodes_lock);
+}
+
+/* Returns a hash value for inode E. */
+static unsigned
+inode_hash (const struct hash_elem *e, void *aux UNUSED)
+{
+  return hash_int (hash_entry (e, struct inode, elem)->sector);
+}
+
+/* Returns true if inode A's sector precedes inode B's. */
+static bool
+inode_less (const struct hash_elem *a, const struct hash_elem *b,
+            void *aux UNUSED)
+{
+  return (hash_entry (a, struct inode, elem)->sector
+          < hash_entry (b, struct inode, elem)->sector);
 }
 
 /* Initializes an inode with LENGTH bytes of data and
    writes the new inode to sector SECTOR on the file system
-   device.
+   device.  The data reads as zeros.  It is kept in the inode if
+   it is small enough, and is otherwise a single hole, which takes
+   no disk space until it is written.  IS_DIR records whether the
+   inode is a directory.
    Returns true if successful.
-   Returns false if memory or disk allocation fails. */
+   Returns false if memory allocation fails. */
 bool
-inode_create (block_sector_t sector, off_t length)
+inode_create (block_sector_t sector, off_t length, bool is_dir)
 {
   struct inode_disk *disk_inode = NULL;
   bool success = false;
@@ -84,23 +720,15 @@ inode_create (block_sector_t sector, off_t length)
   disk_inode = calloc (1, sizeof *disk_inode);
   if (disk_inode != NULL)
     {
-      size_t sectors = bytes_to_sectors (length);
       disk_inode->length = length;
       disk_inode->magic = INODE_MAGIC;
-      if (free_map_allocate (sectors, &disk_inode->start)) 
-        {
-          block_write (fs_device, sector, disk_inode);
-          if (sectors > 0) 
-            {
-              static char zeros[BLOCK_SECTOR_SIZE];
-              size_t i;
-              
-              for (i = 0; i < sectors; i++) 
-                block_write (fs_device, disk_inode->start + i, zeros);
-            }
-          success = true; 
-        } 
+      if (length <= (off_t) INLINE_MAX)
+        disk_inode->flags |= INODE_INLINE;
+      if (is_dir)
+        disk_inode->flags |= INODE_DIR;
+      journal_write (sector, disk_inode);
       free (disk_inode);
+      success = true; 
     }
   return success;
 }
@@ -111,33 +739,64 @@ inode_create (block_sector_t sector, off_t length)
 struct inode *
 inode_open (block_sector_t sector)
 {
-  struct list_elem *e;
+  struct hash_elem *e;
   struct inode *inode;
+  struct inode key;
+
+  lock_acquire (&open_inodes_lock);
 
   /* Check whether this inode is already open. */
-  for (e = list_begin (&open_inodes); e != list_end (&open_inodes);
-       e = list_next (e)) 
+  key.sector = sector;
+  e = hash_find (&open_inodes, &key.elem);
+  if (e != NULL)
     {
-      inode = list_entry (e, struct inode, elem);
-      if (inode->sector == sector) 
+      bool loading;
+
+      inode = hash_entry (e, struct inode, elem);
+      inode->open_cnt++;
+      loading = inode->loading;
+      lock_release (&open_inodes_lock);
+
+      /* Wait for the opener that is reading the inode. */
+      if (loading)
         {
-          inode_reopen (inode);
-          return inode; 
+          rw_read_acquire (&inode->rw);
+          rw_read_release (&inode->rw);
         }
+      return inode; 
     }
 
   /* Allocate memory. */
   inode = malloc (sizeof *inode);
   if (inode == NULL)
-    return NULL;
+    {
+      lock_release (&open_inodes_lock);
+      return NULL;
+    }
 
   /* Initialize. */
-  list_push_front (&open_inodes, &inode->elem);
   inode->sector = sector;
+  hash_insert (&open_inodes, &inode->elem);
+  if (hash_size (&open_inodes) > peak_open_cnt)
+    peak_open_cnt = hash_size (&open_inodes);
   inode->open_cnt = 1;
   inode->deny_write_cnt = 0;
   inode->removed = false;
-  block_read (fs_device, inode->sector, &inode->data);
+  inode->loading = true;
+  inode->hint = 0;
+  inode->journaled = false;
+  rw_init (&inode->rw);
+  lock_init (&inode->dir_lock);
+
+  /* Read the inode with only its own lock held, so that opening
+     and closing other inodes need not wait for the disk. */
+  rw_write_acquire (&inode->rw);
+  lock_release (&open_inodes_lock);
+  cache_read (inode->sector, &inode->data);
+  lock_acquire (&open_inodes_lock);
+  inode->loading = false;
+  lock_release (&open_inodes_lock);
+  rw_write_release (&inode->rw);
   return inode;
 }
 
@@ -146,7 +805,11 @@ struct inode *
 inode_reopen (struct inode *inode)
 {
   if (inode != NULL)
-    inode->open_cnt++;
+    {
+      lock_acquire (&open_inodes_lock);
+      inode->open_cnt++;
+      lock_release (&open_inodes_lock);
+    }
   return inode;
 }
 
@@ -163,22 +826,26 @@ inode_get_inumber (const struct inode *inode)
 void
 inode_close (struct inode *inode) 
 {
+  bool last;
+
   /* Ignore null pointer. */
   if (inode == NULL)
     return;
 
+  lock_acquire (&open_inodes_lock);
+  last = --inode->open_cnt == 0;
+  if (last)
+    hash_delete (&open_inodes, &inode->elem);
+  lock_release (&open_inodes_lock);
+
   /* Release resources if this was the last opener. */
-  if (--inode->open_cnt == 0)
+  if (last)
     {
-      /* Remove from inode list and release lock. */
-      list_remove (&inode->elem);
- 
       /* Deallocate blocks if removed. */
       if (inode->removed) 
         {
           free_map_release (inode->sector, 1);
-          free_map_release (inode->data.start,
-                            bytes_to_sectors (inode->data.length)); 
+          release_sectors (&inode->data);
         }
 
       free (inode); 
@@ -191,18 +858,63 @@ void
 inode_remove (struct inode *inode) 
 {
   ASSERT (inode != NULL);
+  lock_acquire (&open_inodes_lock);
   inode->removed = true;
+  lock_release (&open_inodes_lock);
 }
 
-/* Reads SIZE bytes from INODE into BUFFER, starting at position OFFSET.
+/* Returns true if INODE is a directory. */
+bool
+inode_is_dir (const struct inode *inode) 
+{
+  return (inode->data.flags & INODE_DIR) != 0;
+}
+
+/* Marks INODE as holding file system metadata, such as a
+   directory, so that writes to its data are journaled. */
+void
+inode_set_journaled (struct inode *inode) 
+{
+  inode->journaled = true;
+}
+
+/* Acquires INODE's directory lock, which directory operations
+   hold to keep a directory's entries consistent. */
+void
+inode_lock (struct inode *inode) 
+{
+  lock_acquire (&inode->dir_lock);
+}
+
+/* Releases INODE's directory lock. */
+void
+inode_unlock (struct inode *inode) 
+{
+  lock_release (&inode->dir_lock);
+}
+
+/* Reads SIZE bytes from INODE into BUFFER, starting at position
+   OFFSET.  If DIRECT is true, whole sectors that are not cached
+   are read from disk straight into BUFFER.  INODE's RW must be
+   held for reading.
    Returns the number of bytes actually read, which may be less
-   than SIZE if an error occurs or end of file is reached. */
-off_t
-inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset) 
+   than SIZE if end of file is reached. */
+static off_t
+read_at (struct inode *inode, uint8_t *buffer, off_t size, off_t offset,
+         bool direct) 
 {
-  uint8_t *buffer = buffer_;
   off_t bytes_read = 0;
-  uint8_t *bounce = NULL;
+
+  if (inode->data.flags & INODE_INLINE)
+    {
+      /* Copy the data out of the inode. */
+      off_t inode_left = inode_length (inode) - offset;
+      if (inode_left <= 0)
+        return 0;
+      bytes_read = size < inode_left ? size : inode_left;
+      memcpy (buffer, inode->data.inline_data + offset, bytes_read);
+      return bytes_read;
+    }
 
   while (size > 0) 
     {
@@ -220,50 +932,122 @@ inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset)
       if (chunk_size <= 0)
         break;
 
-      if (sector_ofs == 0 && chunk_size == BLOCK_SECTOR_SIZE)
+      /* Copy the chunk out of the buffer cache, or zeros for a
+         hole.  A direct read takes in every following whole
+         sector that is contiguous on disk. */
+      if (sector_idx == 0)
+        memset (buffer + bytes_read, 0, chunk_size);
+      else if (direct && chunk_size == BLOCK_SECTOR_SIZE)
         {
-          /* Read full sector directly into caller's buffer. */
-          block_read (fs_device, sector_idx, buffer + bytes_read);
-        }
-      else 
-        {
-          /* Read sector into bounce buffer, then partially copy
-             into caller's buffer. */
-          if (bounce == NULL) 
+          size_t cnt = 1;
+          while (size - chunk_size >= BLOCK_SECTOR_SIZE
+                 && inode_left - chunk_size >= BLOCK_SECTOR_SIZE
+                 && (byte_to_sector (inode, offset + chunk_size)
+                     == sector_idx + cnt))
             {
-              bounce = malloc (BLOCK_SECTOR_SIZE);
-              if (bounce == NULL)
-                break;
+              chunk_size += BLOCK_SECTOR_SIZE;
+              cnt++;
             }
-          block_read (fs_device, sector_idx, bounce);
-          memcpy (buffer + bytes_read, bounce + sector_ofs, chunk_size);
+          cache_read_direct (sector_idx, buffer + bytes_read, cnt);
         }
+      else
+        cache_read_at (sector_idx, buffer + bytes_read, sector_ofs,
+                       chunk_size);
       
       /* Advance. */
       size -= chunk_size;
       offset += chunk_size;
       bytes_read += chunk_size;
     }
-  free (bounce);
 
   return bytes_read;
 }
 
-/* Writes SIZE bytes from BUFFER into INODE, starting at OFFSET.
-   Returns the number of bytes actually written, which may be
-   less than SIZE if end of file is reached or an error occurs.
-   (Normally a write at end of file would extend the inode, but
-   growth is not yet implemented.) */
+/* Reads SIZE bytes from INODE into BUFFER, starting at position OFFSET.
+   Returns the number of bytes actually read, which may be less
+   than SIZE if an error occurs or end of file is reached. */
 off_t
-inode_write_at (struct inode *inode, const void *buffer_, off_t size,
-                off_t offset) 
+inode_read_at (struct inode *inode, void *buffer, off_t size, off_t offset) 
+{
+  struct iovec iov;
+
+  iov.iov_base = buffer;
+  iov.iov_len = size;
+  return inode_readv (inode, &iov, 1, offset);
+}
+
+/* Reads from INODE into the IOV_CNT buffers in IOV, filling each
+   in turn, starting at position OFFSET.  INODE is locked once for
+   all of the buffers.  A read of INODE_DIRECT_MIN bytes or more
+   bypasses the buffer cache for sectors that it does not hold.
+   Returns the number of bytes actually read, which may be less
+   than the buffers' total size if end of file is reached. */
+off_t
+inode_readv (struct inode *inode, const struct iovec *iov, int iov_cnt,
+             off_t offset) 
+{
+  off_t bytes_read = 0;
+  off_t total = 0;
+  bool direct;
+  int i;
+
+  for (i = 0; i < iov_cnt; i++)
+    total += iov[i].iov_len;
+  direct = total >= INODE_DIRECT_MIN;
+
+  rw_read_acquire (&inode->rw);
+  for (i = 0; i < iov_cnt; i++)
+    {
+      off_t size = iov[i].iov_len;
+      off_t chunk = read_at (inode, iov[i].iov_base, size,
+                             offset + bytes_read, direct);
+      bytes_read += chunk;
+      if (chunk < size)
+        break;
+    }
+  rw_read_release (&inode->rw);
+
+  return bytes_read;
+}
+
+/* Starts reading the sectors of INODE that hold the SIZE bytes
+   starting at OFFSET into the buffer cache in the background.
+   Holes and sectors past end of file are ignored. */
+void
+inode_readahead (struct inode *inode, off_t offset, off_t size)
+{
+  off_t end = offset + size;
+
+  rw_read_acquire (&inode->rw);
+  if (end > inode_length (inode))
+    end = inode_length (inode);
+  for (offset = ROUND_DOWN (offset, BLOCK_SECTOR_SIZE); offset < end;
+       offset += BLOCK_SECTOR_SIZE)
+    {
+      block_sector_t sector = byte_to_sector (inode, offset);
+      if (sector != 0)
+        cache_readahead (sector);
+    }
+  rw_read_release (&inode->rw);
+}
+
+/* Writes SIZE bytes from BUFFER into INODE, starting at OFFSET,
+   into sectors or inline data that have already been allocated
+   for them.  INODE's RW must be held.
+   Returns the number of bytes actually written, which is less
+   than SIZE only if some of the sectors could not be allocated. */
+static off_t
+write_at (struct inode *inode, const uint8_t *buffer, off_t size,
+          off_t offset) 
 {
-  const uint8_t *buffer = buffer_;
   off_t bytes_written = 0;
-  uint8_t *bounce = NULL;
 
-  if (inode->deny_write_cnt)
-    return 0;
+  if (inode->data.flags & INODE_INLINE)
+    {
+      ASSERT (offset + size <= inode_length (inode));
+      memcpy (inode->data.inline_data + offset, buffer, size);
+      return size;
+    }
 
   while (size > 0) 
     {
@@ -276,44 +1060,187 @@ inode_write_at (struct inode *inode, const void *buffer_, off_t size,
       int sector_left = BLOCK_SECTOR_SIZE - sector_ofs;
       int min_left = inode_left < sector_left ? inode_left : sector_left;
 
-      /* Number of bytes to actually write into this sector. */
+      /* Number of bytes to actually write into this sector.  Stop
+         at a hole, which is left only if the disk is full. */
       int chunk_size = size < min_left ? size : min_left;
-      if (chunk_size <= 0)
+      if (chunk_size <= 0 || sector_idx == 0)
         break;
 
-      if (sector_ofs == 0 && chunk_size == BLOCK_SECTOR_SIZE)
+      /* Copy the chunk into the buffer cache, which reads in the
+         rest of the sector first if the chunk doesn't cover it. */
+      if (inode->journaled)
+        journal_write_at (sector_idx, buffer + bytes_written, sector_ofs,
+                          chunk_size);
+      else
+        cache_write_at (sector_idx, buffer + bytes_written, sector_ofs,
+                        chunk_size);
+
+      /* Advance. */
+      size -= chunk_size;
+      offset += chunk_size;
+      bytes_written += chunk_size;
+    }
+
+  return bytes_written;
+}
+
+/* Writes SIZE bytes from BUFFER into INODE, starting at OFFSET.
+   A write past end of file extends INODE.  Sectors are allocated
+   for the bytes written, including any that fill a hole; a gap
+   between the old end of file and OFFSET is left as a hole,
+   which reads back as zeros.
+   Returns the number of bytes actually written, which may be
+   less than SIZE if the disk fills up or the file reaches its
+   maximum size. */
+off_t
+inode_write_at (struct inode *inode, const void *buffer, off_t size,
+                off_t offset) 
+{
+  struct iovec iov;
+
+  iov.iov_base = (void *) buffer;
+  iov.iov_len = size;
+  return inode_writev (inode, &iov, 1, offset);
+}
+
+/* Writes SIZE bytes into INODE at OFFSET, taking them from the
+   IOV_CNT buffers in IOV starting SKIP bytes into the first, into
+   sectors or inline data that have already been allocated for
+   them.  INODE's RW must be held.
+   Returns the number of bytes actually written. */
+static off_t
+write_iov (struct inode *inode, const struct iovec *iov, int iov_cnt,
+           off_t skip, off_t size, off_t offset)
+{
+  off_t bytes_written = 0;
+  int i;
+
+  for (i = 0; i < iov_cnt && bytes_written < size; i++)
+    {
+      off_t chunk_size = iov[i].iov_len;
+      off_t chunk;
+
+      if (skip >= chunk_size)
         {
-          /* Write full sector directly to disk. */
-          block_write (fs_device, sector_idx, buffer + bytes_written);
+          skip -= chunk_size;
+          continue;
         }
-      else 
+      chunk_size -= skip;
+      if (chunk_size > size - bytes_written)
+        chunk_size = size - bytes_written;
+      chunk = write_at (inode, (const uint8_t *) iov[i].iov_base + skip,
+                        chunk_size, offset + bytes_written);
+      bytes_written += chunk;
+      skip = 0;
+      if (chunk < chunk_size)
+        break;
+    }
+  return bytes_written;
+}
+
+/* Like write_iov(), but first allocates sectors for the bytes to
+   be written and extends INODE if they go past end of file.  For
+   a regular file, allocates at most EXTEND_RUNS runs of sectors,
+   so that the journal changes stay within EXTEND_JOURNAL_MAX.
+   INODE's RW must be held for writing.
+   Returns the number of bytes actually written. */
+static off_t
+write_extend (struct inode *inode, const struct iovec *iov, int iov_cnt,
+              off_t skip, off_t size, off_t offset)
+{
+  off_t mapped;
+
+  /* A small file's data is written into the inode itself, until
+     the file grows too big for that. */
+  if (inode->data.flags & INODE_INLINE)
+    {
+      if (offset + size <= (off_t) INLINE_MAX)
         {
-          /* We need a bounce buffer. */
-          if (bounce == NULL) 
-            {
-              bounce = malloc (BLOCK_SECTOR_SIZE);
-              if (bounce == NULL)
-                break;
-            }
+          off_t bytes_written;
 
-          /* If the sector contains data before or after the chunk
-             we're writing, then we need to read in the sector
-             first.  Otherwise we start with a sector of all zeros. */
-          if (sector_ofs > 0 || chunk_size < sector_left) 
-            block_read (fs_device, sector_idx, bounce);
-          else
-            memset (bounce, 0, BLOCK_SECTOR_SIZE);
-          memcpy (bounce + sector_ofs, buffer + bytes_written, chunk_size);
-          block_write (fs_device, sector_idx, bounce);
+          if (offset + size > inode->data.length)
+            inode->data.length = offset + size;
+          bytes_written = write_iov (inode, iov, iov_cnt, skip, size, offset);
+          journal_write (inode->sector, &inode->data);
+          return bytes_written;
         }
+      if (!move_inline (inode))
+        return 0;
+    }
 
-      /* Advance. */
-      size -= chunk_size;
-      offset += chunk_size;
-      bytes_written += chunk_size;
+  mapped = map_range (inode, offset, size,
+                      inode->journaled ? SIZE_MAX : EXTEND_RUNS);
+  if (offset + mapped > inode->data.length)
+    inode->data.length = offset + mapped;
+  journal_write (inode->sector, &inode->data);
+  return write_iov (inode, iov, iov_cnt, skip, mapped, offset);
+}
+
+/* Writes the IOV_CNT buffers in IOV, one after another, into
+   INODE starting at OFFSET, as inode_write_at() would write them
+   all at once.  INODE is locked, and sectors are allocated, once
+   for all of the buffers, except that a regular file is extended
+   in pieces of at most MAX_RUN sectors and EXTEND_RUNS runs.
+   Returns the number of bytes actually written, which may be
+   less than the buffers' total size if the disk fills up or the
+   file reaches its maximum size. */
+off_t
+inode_writev (struct inode *inode, const struct iovec *iov, int iov_cnt,
+              off_t offset) 
+{
+  bool journaled = inode->journaled;
+  off_t size = 0;
+  off_t bytes_written = 0;
+  int i;
+
+  for (i = 0; i < iov_cnt; i++)
+    size += iov[i].iov_len;
+
+  /* Writing into sectors that are already allocated needs only
+     shared access.  Allocated sectors are never freed while the
+     inode is open, so the check cannot go stale once made. */
+  rw_read_acquire (&inode->rw);
+  if (is_mapped (inode, offset, size))
+    {
+      if (!inode->deny_write_cnt)
+        bytes_written = write_iov (inode, iov, iov_cnt, 0, size, offset);
+      rw_read_release (&inode->rw);
+      return bytes_written;
     }
-  free (bounce);
+  rw_read_release (&inode->rw);
+
+  /* Writing past end of file or into a hole changes the file's
+     metadata, so it needs exclusive access.  Changes to journaled
+     inodes are part of whatever operation is writing them.  A
+     regular file is extended in pieces, each a journaled
+     operation of its own that reserves EXTEND_JOURNAL_MAX
+     sectors of the journal, however big its extent tree is.  A
+     piece that runs out of runs is finished by the next one. */
+  while (bytes_written < size)
+    {
+      off_t pos = offset + bytes_written;
+      off_t piece = size - bytes_written;
+      off_t chunk;
 
+      if (!journaled)
+        {
+          off_t max = MAX_RUN * BLOCK_SECTOR_SIZE - pos % BLOCK_SECTOR_SIZE;
+          if (piece > max)
+            piece = max;
+          journal_begin (EXTEND_JOURNAL_MAX);
+        }
+      rw_write_acquire (&inode->rw);
+      chunk = 0;
+      if (!inode->deny_write_cnt)
+        chunk = write_extend (inode, iov, iov_cnt, bytes_written, piece, pos);
+      rw_write_release (&inode->rw);
+      if (!journaled)
+        journal_end (EXTEND_JOURNAL_MAX);
+
+      bytes_written += chunk;
+      if (chunk == 0)
+        break;
+    }
   return bytes_written;
 }
 
@@ -322,8 +1249,10 @@ inode_write_at (struct inode *inode, const void *buffer_, off_t size,
 void
 inode_deny_write (struct inode *inode) 
 {
+  rw_write_acquire (&inode->rw);
   inode->deny_write_cnt++;
   ASSERT (inode->deny_write_cnt <= inode->open_cnt);
+  rw_write_release (&inode->rw);
 }
 
 /* Re-enables writes to INODE.
@@ -332,9 +1261,11 @@ inode_deny_write (struct inode *inode)
 void
 inode_allow_write (struct inode *inode) 
 {
+  rw_write_acquire (&inode->rw);
   ASSERT (inode->deny_write_cnt > 0);
   ASSERT (inode->deny_write_cnt <= inode->open_cnt);
   inode->deny_write_cnt--;
+  rw_write_release (&inode->rw);
 }
 
 /* Returns the length, in bytes, of INODE's data. */
@@ -343,3 +1274,23 @@ inode_length (const struct inode *inode)
 {
   return inode->data.length;
 }
+
+/* Returns the most sectors that writes to a journaled inode no
+   more than LENGTH bytes long can change through the journal:
+   the inode, each of its data sectors, and its extent tree,
+   which has at most one extent per data sector. */
+size_t
+inode_journal_max (off_t length)
+{
+  size_t sector_cnt = bytes_to_sectors (length);
+
+  return 1 + sector_cnt + tree_sectors (sector_cnt);
+}
+
+/* Prints inode statistics. */
+void
+inode_print_stats (void)
+{
+  printf ("Inodes: %zu open, %zu peak open\n",
+          hash_size (&open_inodes), peak_open_cnt);
+}
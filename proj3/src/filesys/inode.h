@@ -2,22 +2,39 @@
 #define FILESYS_INODE_H
 
 #include <stdbool.h>
+#include <stddef.h>
 #include "filesys/off_t.h"
 #include "devices/block.h"
 
 struct bitmap;
+struct iovec;
+
+/* Reads of at least this many bytes copy sectors that are not in
+   the buffer cache straight from disk into the caller's buffer. */
+#define INODE_DIRECT_MIN 4096
 
 void inode_init (void);
-bool inode_create (block_sector_t, off_t);
+bool inode_create (block_sector_t, off_t, bool is_dir);
 struct inode *inode_open (block_sector_t);
 struct inode *inode_reopen (struct inode *);
 block_sector_t inode_get_inumber (const struct inode *);
 void inode_close (struct inode *);
 void inode_remove (struct inode *);
+bool inode_is_dir (const struct inode *);
+void inode_set_journaled (struct inode *);
+void inode_lock (struct inode *);
+void inode_unlock (struct inode *);
 off_t inode_read_at (struct inode *, void *, off_t size, off_t offset);
+off_t inode_readv (struct inode *, const struct iovec *, int iov_cnt,
+                   off_t offset);
+void inode_readahead (struct inode *, off_t offset, off_t size);
 off_t inode_write_at (struct inode *, const void *, off_t size, off_t offset);
+off_t inode_writev (struct inode *, const struct iovec *, int iov_cnt,
+                    off_t offset);
 void inode_deny_write (struct inode *);
 void inode_allow_write (struct inode *);
 off_t inode_length (const struct inode *);
+size_t inode_journal_max (off_t length);
+void inode_print_stats (void);
 
 #endif /* filesys/inode.h */
@@ -0,0 +1,302 @@
+#include "filesys/journal.h"
+#include <debug.h>
+#include <hash.h>
+#include <stdio.h>
+#include <string.h>
+#include "filesys/cache.h"
+#include "filesys/filesys.h"
+#include "filesys/free-map.h"
+#include "threads/synch.h"
+
+/* Metadata journal.
+
+   Changes to file system metadata (inodes, extent tree sectors,
+   directory contents, and the free map) are made with
+   journal_write() or journal_write_at().  They go into the buffer
+   cache as usual, but are pinned there, so that none of them
+   reaches its home location until the running transaction
+   commits.
+
+   A commit first writes a copy of every sector changed by the
+   transaction into the journal area, then the journal header,
+   which lists the sectors and a checksum of the copies.  Only
+   then are the sectors written home and unpinned.  If the system
+   crashes before the header is written, none of the
+   transaction's changes reached the disk; if it crashes after,
+   journal_init() copies the sectors home again when the file
+   system is next mounted.  Once all of them are home, the header
+   is replaced by an empty one, so that a later mount does not
+   replay old contents over newer changes.  Data sectors of
+   regular files are never journaled.
+
+   Transactions are committed in groups: an operation such as
+   creating a file runs between journal_begin() and journal_end(),
+   and a commit, which waits for running operations to end,
+   happens only every write-behind pass or once SOFT_MAX sectors
+   have been changed.
+
+   A commit never happens in the midst of an operation, so an
+   operation must not change more sectors than the journal has
+   room for.  journal_begin() therefore takes the most sectors
+   the operation can change and reserves them, first committing
+   the running transaction if that is needed to make room.  Room
+   for the free map, which each commit adds to the transaction,
+   is always kept free. */
+
+/* Skip writing home the last commit's sectors?  See journal.h. */
+bool journal_crash;
+
+/* Sectors changed before a commit is started at the end of an
+   operation. */
+#define SOFT_MAX (JOURNAL_MAX / 2)
+
+/* Identifies a journal header. */
+#define JOURNAL_MAGIC 0x4c4e524a
+
+/* On-disk journal header. */
+struct journal_header
+  {
+    unsigned magic;                     /* JOURNAL_MAGIC. */
+    uint32_t seq;                       /* Transaction sequence number. */
+    uint32_t cnt;                       /* Number of sectors logged. */
+    uint32_t checksum;                  /* Checksum of logged sectors. */
+    block_sector_t sectors[JOURNAL_MAX]; /* Home sector of each copy. */
+    uint8_t unused[BLOCK_SECTOR_SIZE - 16 - 4 * JOURNAL_MAX];
+  };
+
+/* Sectors changed by the running transaction, and sectors
+   reserved by running operations, protected by JOURNAL_LOCK. */
+static block_sector_t txn[JOURNAL_MAX];
+static size_t txn_cnt;
+static size_t reserved_cnt;
+static uint32_t seq;
+static struct lock journal_lock;
+
+/* Set by journal_done() for the last commit. */
+static bool done;
+
+/* Held for reading by each running operation, and for writing
+   by a group commit. */
+static struct rwlock commit_rw;
+
+/* Statistics. */
+static unsigned long long commit_cnt;   /* Transactions committed. */
+static unsigned long long logged_cnt;   /* Sectors written to journal. */
+
+static void commit (void);
+static void clear_header (void);
+static uint32_t checksum (uint32_t, const void *);
+
+/* Initializes the journal.  If FORMAT is true, clears the journal
+   area; otherwise, replays the last committed transaction. */
+void
+journal_init (bool format) 
+{
+  static struct journal_header h;
+  static uint8_t data[BLOCK_SECTOR_SIZE];
+  uint32_t sum;
+  size_t i;
+
+  ASSERT (sizeof h == BLOCK_SECTOR_SIZE);
+
+  lock_init (&journal_lock);
+  rw_init (&commit_rw);
+  txn_cnt = 0;
+  reserved_cnt = 0;
+
+  if (!format)
+    {
+      block_read (fs_device, JOURNAL_SECTOR, &h);
+      if (h.magic == JOURNAL_MAGIC && h.cnt <= JOURNAL_MAX)
+        {
+          /* The copies are good only if they match the header. */
+          sum = h.seq;
+          for (i = 0; i < h.cnt; i++)
+            {
+              block_read (fs_device, JOURNAL_SECTOR + 1 + i, data);
+              sum = checksum (sum, data);
+            }
+          if (sum == h.checksum)
+            for (i = 0; i < h.cnt; i++)
+              {
+                block_read (fs_device, JOURNAL_SECTOR + 1 + i, data);
+                block_write (fs_device, h.sectors[i], data);
+              }
+          seq = h.seq + 1;
+        }
+    }
+
+  clear_header ();
+}
+
+/* Starts an operation whose changes must be committed together
+   and that changes at most CNT sectors, which must not exceed
+   JOURNAL_OP_MAX.  Waits for the running transaction to commit if
+   it does not have room for CNT more sectors.  Operations may not
+   nest. */
+void
+journal_begin (size_t cnt) 
+{
+  ASSERT (cnt <= JOURNAL_OP_MAX);
+
+  lock_acquire (&journal_lock);
+  while (txn_cnt + reserved_cnt + cnt + free_map_journal_max ()
+         > JOURNAL_MAX)
+    {
+      lock_release (&journal_lock);
+      journal_commit ();
+      lock_acquire (&journal_lock);
+    }
+  reserved_cnt += cnt;
+  lock_release (&journal_lock);
+
+  rw_read_acquire (&commit_rw);
+}
+
+/* Ends an operation started with journal_begin(CNT), committing
+   the running transaction if it has grown large. */
+void
+journal_end (size_t cnt) 
+{
+  bool full;
+
+  lock_acquire (&journal_lock);
+  ASSERT (reserved_cnt >= cnt);
+  reserved_cnt -= cnt;
+  full = txn_cnt >= SOFT_MAX;
+  lock_release (&journal_lock);
+
+  rw_read_release (&commit_rw);
+  if (full)
+    journal_commit ();
+}
+
+/* Writes BLOCK_SECTOR_SIZE bytes of metadata from BUFFER into
+   SECTOR as part of the running transaction. */
+void
+journal_write (block_sector_t sector, const void *buffer) 
+{
+  journal_write_at (sector, buffer, 0, BLOCK_SECTOR_SIZE);
+}
+
+/* Writes SIZE bytes of metadata from BUFFER into SECTOR,
+   starting at byte offset OFS within the sector, as part of the
+   running transaction. */
+void
+journal_write_at (block_sector_t sector, const void *buffer,
+                  int ofs, int size) 
+{
+  size_t i;
+
+  lock_acquire (&journal_lock);
+  for (i = 0; i < txn_cnt; i++)
+    if (txn[i] == sector)
+      break;
+  if (i == txn_cnt)
+    {
+      /* journal_begin() reserved room for this sector. */
+      ASSERT (txn_cnt < JOURNAL_MAX);
+      txn[txn_cnt++] = sector;
+    }
+  cache_write_pinned (sector, buffer, ofs, size);
+  lock_release (&journal_lock);
+}
+
+/* Commits the running transaction once no operation is in
+   progress, along with the changes to the free map made by the
+   operations in it. */
+void
+journal_commit (void) 
+{
+  rw_write_acquire (&commit_rw);
+  free_map_sync ();
+  lock_acquire (&journal_lock);
+  commit ();
+  lock_release (&journal_lock);
+  rw_write_release (&commit_rw);
+}
+
+/* Commits the running transaction for the last time, at
+   shutdown. */
+void
+journal_done (void) 
+{
+  done = true;
+  journal_commit ();
+}
+
+/* Prints journal statistics. */
+void
+journal_print_stats (void) 
+{
+  printf ("Journal: %llu commits, %llu sectors logged\n",
+          commit_cnt, logged_cnt);
+}
+
+/* Writes the running transaction to the journal, then writes its
+   sectors home.  The journal lock must be held. */
+static void
+commit (void) 
+{
+  static struct journal_header h;
+  static uint8_t data[BLOCK_SECTOR_SIZE];
+  size_t i;
+
+  ASSERT (lock_held_by_current_thread (&journal_lock));
+
+  if (txn_cnt == 0)
+    return;
+
+  /* Log the sectors, then write the header that commits them. */
+  memset (&h, 0, sizeof h);
+  h.magic = JOURNAL_MAGIC;
+  h.seq = seq++;
+  h.cnt = txn_cnt;
+  h.checksum = h.seq;
+  for (i = 0; i < txn_cnt; i++)
+    {
+      cache_read (txn[i], data);
+      block_write (fs_device, JOURNAL_SECTOR + 1 + i, data);
+      h.sectors[i] = txn[i];
+      h.checksum = checksum (h.checksum, data);
+    }
+  block_write (fs_device, JOURNAL_SECTOR, &h);
+
+  /* Write the sectors home, so that the journal area can be
+     reused by the next commit, then clear the header, so that
+     the next mount does not replay them over later changes.  A
+     simulated crash leaves them pinned, so that the cache does
+     not write them either, and leaves the header for replay. */
+  if (!done || !journal_crash)
+    {
+      for (i = 0; i < txn_cnt; i++)
+        cache_unpin (txn[i]);
+      clear_header ();
+    }
+
+  commit_cnt++;
+  logged_cnt += txn_cnt;
+  txn_cnt = 0;
+}
+
+/* Writes a journal header that commits no sectors, marking every
+   earlier transaction as written home. */
+static void
+clear_header (void) 
+{
+  static struct journal_header h;
+
+  memset (&h, 0, sizeof h);
+  h.magic = JOURNAL_MAGIC;
+  h.seq = seq;
+  h.checksum = seq;
+  block_write (fs_device, JOURNAL_SECTOR, &h);
+}
+
+/* Returns checksum SUM updated with the BLOCK_SECTOR_SIZE bytes
+   in DATA. */
+static uint32_t
+checksum (uint32_t sum, const void *data) 
+{
+  return sum * 31 + hash_bytes (data, BLOCK_SECTOR_SIZE);
+}
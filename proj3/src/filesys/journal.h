@@ -0,0 +1,35 @@
+#ifndef FILESYS_JOURNAL_H
+#define FILESYS_JOURNAL_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "devices/block.h"
+
+/* Journal location: a header sector followed by JOURNAL_MAX
+   sectors of logged data, just after the root directory.  Every
+   sector of a transaction stays pinned in the buffer cache until
+   it commits, so JOURNAL_MAX must leave room in the cache. */
+#define JOURNAL_SECTOR 2
+#define JOURNAL_MAX 48
+
+/* Most sectors that a single operation may reserve.  The rest of
+   the journal is kept for the free map. */
+#define JOURNAL_OP_MAX (JOURNAL_MAX * 3 / 4)
+
+/* If true, the last commit at shutdown leaves its sectors
+   unwritten, as if the machine had crashed just after the
+   commit, so that the next mount must replay them from the
+   journal.  Controlled by kernel command-line option "-crash". */
+extern bool journal_crash;
+
+void journal_init (bool format);
+void journal_begin (size_t cnt);
+void journal_end (size_t cnt);
+void journal_write (block_sector_t, const void *);
+void journal_write_at (block_sector_t, const void *, int ofs, int size);
+void journal_commit (void);
+void journal_done (void);
+
+void journal_print_stats (void);
+
+#endif /* filesys/journal.h */
@@ -0,0 +1,23 @@
+#ifndef __LIB_DIRENT_H
+#define __LIB_DIRENT_H
+
+/* Directory entries, as returned by getdents(). */
+
+#include <stdbool.h>
+
+/* Maximum length of a file name in a directory entry. */
+#define DIRENT_NAME_MAX 14
+
+/* Flags for getdents(). */
+#define GETDENTS_STAT 0x1       /* Fill in d_size and d_isdir. */
+
+/* A directory entry. */
+struct dirent
+  {
+    int d_ino;                          /* Inode number. */
+    int d_size;                         /* File size, if GETDENTS_STAT. */
+    bool d_isdir;                       /* Directory?  If GETDENTS_STAT. */
+    char d_name[DIRENT_NAME_MAX + 1];   /* Null-terminated file name. */
+  };
+
+#endif /* lib/dirent.h */
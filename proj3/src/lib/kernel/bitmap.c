@@ -3,6 +3,7 @@
 #include <limits.h>
 #include <round.h>
 #include <stdio.h>
+#include <string.h>
 #include "threads/malloc.h"
 #ifdef FILESYS
 #include "filesys/file.h"
@@ -28,6 +29,10 @@ struct bitmap
   {
     size_t bit_cnt;     /* Number of bits. */
     elem_type *bits;    /* Elements that represent bits. */
+#ifdef FILESYS
+    size_t dirty_start; /* First bit changed since last written. */
+    size_t dirty_end;   /* One past the last bit changed. */
+#endif
   };
 
 /* Returns the index of the element that contains the bit
@@ -69,6 +74,29 @@ last_mask (const struct bitmap *b)
   return last_bits ? ((elem_type) 1 << last_bits) - 1 : (elem_type) -1;
 }
 
+/* Records that the bit numbered BIT_IDX in B has changed, so
+   that bitmap_copy_dirty() will copy it out. */
+static inline void
+mark_dirty (struct bitmap *b UNUSED, size_t bit_idx UNUSED) 
+{
+#ifdef FILESYS
+  if (bit_idx < b->dirty_start)
+    b->dirty_start = bit_idx;
+  if (bit_idx >= b->dirty_end)
+    b->dirty_end = bit_idx + 1;
+#endif
+}
+
+/* Records that B matches its copy on disk. */
+static inline void
+mark_clean (struct bitmap *b UNUSED) 
+{
+#ifdef FILESYS
+  b->dirty_start = b->bit_cnt;
+  b->dirty_end = 0;
+#endif
+}
+
 /* Creation and destruction. */
 
 /* Creates and returns a pointer to a newly allocated bitmap with room for
@@ -85,6 +113,7 @@ bitmap_create (size_t bit_cnt)
       b->bits = malloc (byte_cnt (bit_cnt));
       if (b->bits != NULL || bit_cnt == 0)
         {
+          mark_clean (b);
           bitmap_set_all (b, false);
           return b;
         }
@@ -105,6 +134,7 @@ bitmap_create_in_buf (size_t bit_cnt, void *block, size_t block_size UNUSED)
 
   b->bit_cnt = bit_cnt;
   b->bits = (elem_type *) (b + 1);
+  mark_clean (b);
   bitmap_set_all (b, false);
   return b;
 }
@@ -163,6 +193,7 @@ bitmap_mark (struct bitmap *b, size_t bit_idx)
      is guaranteed to be atomic on a uniprocessor machine.  See
      the description of the OR instruction in [IA32-v2b]. */
   asm ("orl %1, %0" : "=m" (b->bits[idx]) : "r" (mask) : "cc");
+  mark_dirty (b, bit_idx);
 }
 
 /* Atomically sets the bit numbered BIT_IDX in B to false. */
@@ -176,6 +207,7 @@ bitmap_reset (struct bitmap *b, size_t bit_idx)
      is guaranteed to be atomic on a uniprocessor machine.  See
      the description of the AND instruction in [IA32-v2a]. */
   asm ("andl %1, %0" : "=m" (b->bits[idx]) : "r" (~mask) : "cc");
+  mark_dirty (b, bit_idx);
 }
 
 /* Atomically toggles the bit numbered IDX in B;
@@ -191,6 +223,7 @@ bitmap_flip (struct bitmap *b, size_t bit_idx)
      is guaranteed to be atomic on a uniprocessor machine.  See
      the description of the XOR instruction in [IA32-v2b]. */
   asm ("xorl %1, %0" : "=m" (b->bits[idx]) : "r" (mask) : "cc");
+  mark_dirty (b, bit_idx);
 }
 
 /* Returns the value of the bit numbered IDX in B. */
@@ -298,13 +331,49 @@ bitmap_scan (const struct bitmap *b, size_t start, size_t cnt, bool value)
   ASSERT (b != NULL);
   ASSERT (start <= b->bit_cnt);
 
-  if (cnt <= b->bit_cnt) 
+  return bitmap_scan_range (b, start, b->bit_cnt, cnt, value);
+}
+
+/* Finds and returns the starting index of the first group of CNT
+   consecutive bits in B that are all set to VALUE and lie
+   between START and END, exclusive.
+   If there is no such group, returns BITMAP_ERROR.
+
+   Elements whose bits are all equal are skipped a whole element
+   at a time, so scanning a mostly full or mostly empty bitmap
+   costs one comparison per ELEM_BITS bits. */
+size_t
+bitmap_scan_range (const struct bitmap *b, size_t start, size_t end,
+                   size_t cnt, bool value) 
+{
+  elem_type flip = value ? 0 : (elem_type) -1;
+  size_t run = 0;
+  size_t i = start;
+
+  ASSERT (b != NULL);
+  ASSERT (start <= end);
+  ASSERT (end <= b->bit_cnt);
+
+  if (cnt == 0)
+    return start;
+  while (i < end) 
     {
-      size_t last = b->bit_cnt - cnt;
-      size_t i;
-      for (i = start; i <= last; i++)
-        if (!bitmap_contains (b, i, cnt, !value))
-          return i; 
+      /* Bits set to VALUE are 1s in W. */
+      elem_type w = b->bits[elem_idx (i)] ^ flip;
+
+      if (i % ELEM_BITS == 0 && i + ELEM_BITS <= end
+          && (w == 0 || w == (elem_type) -1))
+        {
+          run = w != 0 ? run + ELEM_BITS : 0;
+          i += ELEM_BITS;
+        }
+      else
+        {
+          run = (w & bit_mask (i)) != 0 ? run + 1 : 0;
+          i++;
+        }
+      if (run >= cnt)
+        return i - run;
     }
   return BITMAP_ERROR;
 }
@@ -347,16 +416,52 @@ bitmap_read (struct bitmap *b, struct file *file)
       success = file_read_at (file, b->bits, size, 0) == size;
       b->bits[elem_cnt (b->bit_cnt) - 1] &= last_mask (b);
     }
+  if (success)
+    mark_clean (b);
   return success;
 }
 
 /* Writes B to FILE.  Return true if successful, false
    otherwise. */
 bool
-bitmap_write (const struct bitmap *b, struct file *file)
+bitmap_write (struct bitmap *b, struct file *file)
 {
   off_t size = byte_cnt (b->bit_cnt);
-  return file_write_at (file, b->bits, size, 0) == size;
+  if (file_write_at (file, b->bits, size, 0) != size)
+    return false;
+  mark_clean (b);
+  return true;
+}
+
+/* Copies the part of B that has changed since B was last read,
+   written, or copied into a newly allocated buffer, and marks B
+   clean, so that the caller can write the copy to B's file
+   without keeping B locked.  Stores the buffer into *BUFP, and
+   the byte offset and size of the copied part into *OFSP and
+   *SIZEP; the caller must free the buffer.  If nothing has
+   changed, stores a null pointer into *BUFP.
+   Returns true if successful, false if out of memory, in which
+   case B is left unchanged. */
+bool
+bitmap_copy_dirty (struct bitmap *b, void **bufp, size_t *ofsp,
+                   size_t *sizep)
+{
+  size_t ofs, size;
+
+  *bufp = NULL;
+  if (b->dirty_start >= b->dirty_end)
+    return true;
+
+  ofs = elem_idx (b->dirty_start) * sizeof (elem_type);
+  size = (elem_idx (b->dirty_end - 1) + 1) * sizeof (elem_type) - ofs;
+  *bufp = malloc (size);
+  if (*bufp == NULL)
+    return false;
+  memcpy (*bufp, (uint8_t *) b->bits + ofs, size);
+  *ofsp = ofs;
+  *sizep = size;
+  mark_clean (b);
+  return true;
 }
 #endif /* FILESYS */
 
@@ -0,0 +1,8 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+my ($fs);
+$fs->{"f$_"} = [''] foreach 0...999;
+check_archive ($fs);
+pass;
@@ -0,0 +1,69 @@
+/* Creates more files in the root directory than it can hold
+   without doubling its hash buckets several times, then checks
+   that each file can still be opened and is listed exactly
+   once. */
+
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define FILE_CNT 1000
+#define BATCH_CNT 16
+
+static bool seen[FILE_CNT];
+
+void
+test_main (void) 
+{
+  struct dirent ents[BATCH_CNT];
+  int dir_fd, fd, cnt, total = 0;
+  size_t i;
+
+  for (i = 0; i < FILE_CNT; i++)
+    {
+      char file_name[16];
+
+      snprintf (file_name, sizeof file_name, "f%zu", i);
+      if (!create (file_name, 0))
+        fail ("create \"%s\" failed", file_name);
+    }
+  msg ("created %d files", FILE_CNT);
+
+  for (i = 0; i < FILE_CNT; i++)
+    {
+      char file_name[16];
+
+      snprintf (file_name, sizeof file_name, "f%zu", i);
+      if ((fd = open (file_name)) < 2)
+        fail ("open \"%s\" failed", file_name);
+      close (fd);
+    }
+  msg ("opened %d files", FILE_CNT);
+
+  CHECK ((dir_fd = open ("/")) > 1, "open \"/\"");
+  while ((cnt = getdents (dir_fd, ents, BATCH_CNT, 0)) > 0)
+    {
+      int j;
+
+      for (j = 0; j < cnt; j++)
+        {
+          const char *name = ents[j].d_name;
+          int n;
+
+          if (name[0] != 'f')
+            continue;
+          n = atoi (name + 1);
+          if (n < 0 || n >= FILE_CNT || seen[n])
+            fail ("unexpected entry \"%s\"", name);
+          seen[n] = true;
+          total++;
+        }
+    }
+  if (total != FILE_CNT)
+    fail ("listed %d files instead of %d", total, FILE_CNT);
+  msg ("listed %d files", FILE_CNT);
+}
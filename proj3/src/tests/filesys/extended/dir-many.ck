@@ -0,0 +1,13 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(dir-many) begin
+(dir-many) created 1000 files
+(dir-many) opened 1000 files
+(dir-many) open "/"
+(dir-many) listed 1000 files
+(dir-many) end
+EOF
+pass;
@@ -0,0 +1,32 @@
+/* Tries getdents() on invalid fds, on a regular file, and with a
+   count too large to fit in memory, which must all fail with
+   -1. */
+
+#include <dirent.h>
+#include <limits.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void) 
+{
+  static const int fds[] = {0x20101234, 5, 1234, 0, 1, -1, INT_MIN,
+                            INT_MAX};
+  struct dirent ent;
+  int fd;
+  size_t i;
+
+  for (i = 0; i < sizeof fds / sizeof *fds; i++)
+    if (getdents (fds[i], &ent, 1, 0) != -1)
+      fail ("getdents() on fd %d did not fail", fds[i]);
+
+  CHECK (create ("a", 0), "create \"a\"");
+  CHECK ((fd = open ("a")) > 1, "open \"a\"");
+  CHECK (getdents (fd, &ent, 1, 0) == -1, "getdents \"a\" fails");
+  close (fd);
+
+  CHECK ((fd = open ("/")) > 1, "open \"/\"");
+  CHECK (getdents (fd, &ent, UINT_MAX, 0) == -1,
+         "getdents \"/\" with count UINT_MAX fails");
+}
@@ -0,0 +1,14 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(getdents-bad-fd) begin
+(getdents-bad-fd) create "a"
+(getdents-bad-fd) open "a"
+(getdents-bad-fd) getdents "a" fails
+(getdents-bad-fd) open "/"
+(getdents-bad-fd) getdents "/" with count UINT_MAX fails
+(getdents-bad-fd) end
+EOF
+pass;
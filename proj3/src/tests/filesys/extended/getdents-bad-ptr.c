@@ -0,0 +1,19 @@
+/* Passes an invalid pointer to the getdents system call.
+   The process must be terminated with -1 exit code. */
+
+#include <dirent.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void) 
+{
+  int fd;
+
+  CHECK (mkdir ("a"), "mkdir \"a\"");
+  CHECK ((fd = open ("a")) > 1, "open \"a\"");
+
+  getdents (fd, (struct dirent *) 0xc0100000, 1, 0);
+  fail ("should not have survived getdents()");
+}
@@ -0,0 +1,11 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(getdents-bad-ptr) begin
+(getdents-bad-ptr) mkdir "a"
+(getdents-bad-ptr) open "a"
+getdents-bad-ptr: exit(-1)
+EOF
+pass;
@@ -0,0 +1,51 @@
+/* Lists a directory of many files with getdents() a few entries
+   at a time and checks that each file is listed exactly once. */
+
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define FILE_CNT 40
+#define BATCH_CNT 7
+
+void
+test_main (void) 
+{
+  struct dirent ents[BATCH_CNT];
+  bool seen[FILE_CNT];
+  int dir_fd, cnt, total = 0;
+  size_t i;
+
+  CHECK (mkdir ("a"), "mkdir \"a\"");
+  for (i = 0; i < FILE_CNT; i++)
+    {
+      char file_name[16];
+
+      snprintf (file_name, sizeof file_name, "a/file%zu", i);
+      if (!create (file_name, 0))
+        fail ("create \"%s\" failed", file_name);
+      seen[i] = false;
+    }
+  msg ("created %d files in \"a\"", FILE_CNT);
+  CHECK ((dir_fd = open ("a")) > 1, "open \"a\"");
+
+  while ((cnt = getdents (dir_fd, ents, BATCH_CNT, 0)) > 0)
+    for (i = 0; i < (size_t) cnt; i++)
+      {
+        const char *name = ents[i].d_name;
+        int idx = atoi (name + 4);
+
+        if (memcmp (name, "file", 4) || idx < 0 || idx >= FILE_CNT
+            || seen[idx])
+          fail ("unexpected entry \"%s\"", name);
+        seen[idx] = true;
+        total++;
+      }
+  if (cnt < 0)
+    fail ("getdents \"a\" failed");
+  CHECK (total == FILE_CNT, "listed %d files in \"a\"", FILE_CNT);
+}
@@ -0,0 +1,13 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(getdents-batch) begin
+(getdents-batch) mkdir "a"
+(getdents-batch) created 40 files in "a"
+(getdents-batch) open "a"
+(getdents-batch) listed 40 files in "a"
+(getdents-batch) end
+EOF
+pass;
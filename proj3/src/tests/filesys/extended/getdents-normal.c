@@ -0,0 +1,53 @@
+/* Lists a directory with getdents() and checks that each entry
+   names a file in it, with that file's inode number. */
+
+#include <dirent.h>
+#include <stdio.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+static const char *names[] = {"x", "y", "z"};
+#define NAME_CNT (sizeof names / sizeof *names)
+
+void
+test_main (void) 
+{
+  struct dirent ents[NAME_CNT + 1];
+  bool seen[NAME_CNT] = {false, false, false};
+  int dir_fd, cnt, i;
+
+  CHECK (mkdir ("a"), "mkdir \"a\"");
+  CHECK (create ("a/x", 100), "create \"a/x\"");
+  CHECK (create ("a/y", 0), "create \"a/y\"");
+  CHECK (mkdir ("a/z"), "mkdir \"a/z\"");
+  CHECK ((dir_fd = open ("a")) > 1, "open \"a\"");
+
+  CHECK ((cnt = getdents (dir_fd, ents, NAME_CNT + 1, 0)) == NAME_CNT,
+         "getdents \"a\"");
+  for (i = 0; i < cnt; i++)
+    {
+      char file_name[16];
+      size_t j;
+      int fd;
+
+      for (j = 0; j < NAME_CNT; j++)
+        if (!strcmp (ents[i].d_name, names[j]))
+          break;
+      if (j == NAME_CNT || seen[j])
+        fail ("unexpected entry \"%s\"", ents[i].d_name);
+      seen[j] = true;
+
+      snprintf (file_name, sizeof file_name, "a/%s", names[j]);
+      if ((fd = open (file_name)) < 2)
+        fail ("open \"%s\" failed", file_name);
+      if (inumber (fd) != ents[i].d_ino)
+        fail ("entry for \"%s\" has inode %d instead of %d",
+              file_name, ents[i].d_ino, inumber (fd));
+      close (fd);
+    }
+
+  CHECK (getdents (dir_fd, ents, NAME_CNT + 1, 0) == 0,
+         "getdents \"a\" at end of directory");
+}
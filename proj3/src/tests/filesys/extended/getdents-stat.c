@@ -0,0 +1,52 @@
+/* Lists a directory with getdents() and GETDENTS_STAT and checks
+   each entry's size and type. */
+
+#include <dirent.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+static const struct
+  {
+    const char *name;
+    int size;
+    bool isdir;
+  }
+files[] = {{"x", 100, false}, {"y", 0, false}, {"z", 0, true}};
+#define FILE_CNT (sizeof files / sizeof *files)
+
+void
+test_main (void) 
+{
+  struct dirent ents[FILE_CNT + 1];
+  bool seen[FILE_CNT] = {false, false, false};
+  int dir_fd, cnt, i;
+
+  CHECK (mkdir ("a"), "mkdir \"a\"");
+  CHECK (create ("a/x", 100), "create \"a/x\"");
+  CHECK (create ("a/y", 0), "create \"a/y\"");
+  CHECK (mkdir ("a/z"), "mkdir \"a/z\"");
+  CHECK ((dir_fd = open ("a")) > 1, "open \"a\"");
+
+  CHECK ((cnt = getdents (dir_fd, ents, FILE_CNT + 1, GETDENTS_STAT))
+         == FILE_CNT, "getdents \"a\" with GETDENTS_STAT");
+  for (i = 0; i < cnt; i++)
+    {
+      size_t j;
+
+      for (j = 0; j < FILE_CNT; j++)
+        if (!strcmp (ents[i].d_name, files[j].name))
+          break;
+      if (j == FILE_CNT || seen[j])
+        fail ("unexpected entry \"%s\"", ents[i].d_name);
+      seen[j] = true;
+
+      if (ents[i].d_size != files[j].size)
+        fail ("entry for \"%s\" has size %d instead of %d",
+              files[j].name, ents[i].d_size, files[j].size);
+      if (ents[i].d_isdir != files[j].isdir)
+        fail ("entry for \"%s\" %s a directory",
+              files[j].name, ents[i].d_isdir ? "is" : "is not");
+    }
+}
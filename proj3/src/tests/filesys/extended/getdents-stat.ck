@@ -0,0 +1,15 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(getdents-stat) begin
+(getdents-stat) mkdir "a"
+(getdents-stat) create "a/x"
+(getdents-stat) create "a/y"
+(getdents-stat) mkdir "a/z"
+(getdents-stat) open "a"
+(getdents-stat) getdents "a" with GETDENTS_STAT
+(getdents-stat) end
+EOF
+pass;
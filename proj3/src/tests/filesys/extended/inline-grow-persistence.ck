@@ -0,0 +1,7 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+my ($letters) = join ('', 'a'...'z') x 200;
+check_archive ({"testfile" => [substr ($letters, 0, 5000)]});
+pass;
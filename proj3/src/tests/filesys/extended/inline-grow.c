@@ -0,0 +1,34 @@
+/* Grows a file that starts out with its data inline in the inode
+   until its data has to move out into extents, checking the
+   contents at each step.  Inline data holds up to 492 bytes. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+static char buf[5000];
+
+void
+test_main (void) 
+{
+  static const size_t sizes[] = {300, 492, 493, 5000};
+  size_t ofs = 0, i;
+  int fd;
+
+  for (i = 0; i < sizeof buf; i++)
+    buf[i] = 'a' + i % 26;
+
+  CHECK (create ("testfile", 0), "create \"testfile\"");
+  CHECK ((fd = open ("testfile")) > 1, "open \"testfile\"");
+  for (i = 0; i < sizeof sizes / sizeof *sizes; i++)
+    {
+      size_t size = sizes[i] - ofs;
+
+      CHECK (write (fd, buf + ofs, size) == (int) size,
+             "grow \"testfile\" to %zu bytes", sizes[i]);
+      ofs = sizes[i];
+      check_file ("testfile", buf, ofs);
+    }
+  msg ("close \"testfile\"");
+  close (fd);
+}
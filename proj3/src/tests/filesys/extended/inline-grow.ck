@@ -0,0 +1,28 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(inline-grow) begin
+(inline-grow) create "testfile"
+(inline-grow) open "testfile"
+(inline-grow) grow "testfile" to 300 bytes
+(inline-grow) open "testfile" for verification
+(inline-grow) verified contents of "testfile"
+(inline-grow) close "testfile"
+(inline-grow) grow "testfile" to 492 bytes
+(inline-grow) open "testfile" for verification
+(inline-grow) verified contents of "testfile"
+(inline-grow) close "testfile"
+(inline-grow) grow "testfile" to 493 bytes
+(inline-grow) open "testfile" for verification
+(inline-grow) verified contents of "testfile"
+(inline-grow) close "testfile"
+(inline-grow) grow "testfile" to 5000 bytes
+(inline-grow) open "testfile" for verification
+(inline-grow) verified contents of "testfile"
+(inline-grow) close "testfile"
+(inline-grow) close "testfile"
+(inline-grow) end
+EOF
+pass;
@@ -0,0 +1,7 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_archive ({'a' => {'b' => {'c' => ['0123456789abcdef' x 8]}},
+                'd' => ['']});
+pass;
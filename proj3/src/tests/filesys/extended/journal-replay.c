@@ -0,0 +1,29 @@
+/* Creates directories and a small file, then powers off with
+   the kernel's -crash option, which leaves the last journal
+   commit unwritten.  The persistence check passes only if the
+   next mount replays the commit from the journal. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+static char buf[128];
+
+void
+test_main (void) 
+{
+  size_t i;
+  int fd;
+
+  for (i = 0; i < sizeof buf; i++)
+    buf[i] = "0123456789abcdef"[i % 16];
+
+  CHECK (mkdir ("a"), "mkdir \"a\"");
+  CHECK (mkdir ("a/b"), "mkdir \"a/b\"");
+  CHECK (create ("a/b/c", 0), "create \"a/b/c\"");
+  CHECK ((fd = open ("a/b/c")) > 1, "open \"a/b/c\"");
+  CHECK (write (fd, buf, sizeof buf) == sizeof buf, "write \"a/b/c\"");
+  msg ("close \"a/b/c\"");
+  close (fd);
+  CHECK (create ("d", 0), "create \"d\"");
+}
@@ -0,0 +1,16 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(journal-replay) begin
+(journal-replay) mkdir "a"
+(journal-replay) mkdir "a/b"
+(journal-replay) create "a/b/c"
+(journal-replay) open "a/b/c"
+(journal-replay) write "a/b/c"
+(journal-replay) close "a/b/c"
+(journal-replay) create "d"
+(journal-replay) end
+EOF
+pass;
@@ -0,0 +1,8 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+my ($letters) = join ('', 'a'...'z') x 40;
+check_archive ({"testfile" => [("\0" x 30000) . substr ($letters, 0, 1000)
+                               . ("\0" x (100000 - 31000))]});
+pass;
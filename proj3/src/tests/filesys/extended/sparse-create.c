@@ -0,0 +1,32 @@
+/* Creates a large file, which must read back as zeros, then
+   writes into the middle of it and checks that only the written
+   bytes changed. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define WRITE_OFS 30000
+#define WRITE_SIZE 1000
+
+static char buf[100000];
+
+void
+test_main (void) 
+{
+  size_t i;
+  int fd;
+
+  CHECK (create ("testfile", sizeof buf), "create \"testfile\"");
+  check_file ("testfile", buf, sizeof buf);
+
+  for (i = 0; i < WRITE_SIZE; i++)
+    buf[WRITE_OFS + i] = 'a' + i % 26;
+  CHECK ((fd = open ("testfile")) > 1, "open \"testfile\"");
+  CHECK (pwrite (fd, buf + WRITE_OFS, WRITE_SIZE, WRITE_OFS) == WRITE_SIZE,
+         "write %d bytes at offset %d", WRITE_SIZE, WRITE_OFS);
+  msg ("close \"testfile\"");
+  close (fd);
+
+  check_file ("testfile", buf, sizeof buf);
+}
@@ -0,0 +1,19 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(sparse-create) begin
+(sparse-create) create "testfile"
+(sparse-create) open "testfile" for verification
+(sparse-create) verified contents of "testfile"
+(sparse-create) close "testfile"
+(sparse-create) open "testfile"
+(sparse-create) write 1000 bytes at offset 30000
+(sparse-create) close "testfile"
+(sparse-create) open "testfile" for verification
+(sparse-create) verified contents of "testfile"
+(sparse-create) close "testfile"
+(sparse-create) end
+EOF
+pass;
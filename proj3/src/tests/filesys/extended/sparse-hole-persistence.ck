@@ -0,0 +1,9 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+my ($letters) = join ('', 'a'...'z') x 20;
+check_archive ({"testfile" => [("\0" x 20000) . substr ($letters, 0, 512)
+                               . ("\0" x (60000 - 20512))
+                               . substr ($letters, 0, 100)]});
+pass;
@@ -0,0 +1,42 @@
+/* Writes two runs of data past the end of an empty file, leaving
+   holes before each, and checks that the holes read back as
+   zeros and the data as written. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define FIRST_OFS 20000
+#define FIRST_SIZE 512
+#define SECOND_OFS 60000
+#define SECOND_SIZE 100
+
+static char buf[SECOND_OFS + SECOND_SIZE];
+
+static void
+write_at (int fd, size_t ofs, size_t size) 
+{
+  size_t i;
+
+  for (i = 0; i < size; i++)
+    buf[ofs + i] = 'a' + i % 26;
+  msg ("seek \"testfile\" to %zu", ofs);
+  seek (fd, ofs);
+  CHECK (write (fd, buf + ofs, size) == (int) size,
+         "write %zu bytes to \"testfile\"", size);
+}
+
+void
+test_main (void) 
+{
+  int fd;
+
+  CHECK (create ("testfile", 0), "create \"testfile\"");
+  CHECK ((fd = open ("testfile")) > 1, "open \"testfile\"");
+  write_at (fd, FIRST_OFS, FIRST_SIZE);
+  write_at (fd, SECOND_OFS, SECOND_SIZE);
+  msg ("close \"testfile\"");
+  close (fd);
+
+  check_file ("testfile", buf, sizeof buf);
+}
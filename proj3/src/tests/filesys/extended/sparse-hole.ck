@@ -0,0 +1,19 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(sparse-hole) begin
+(sparse-hole) create "testfile"
+(sparse-hole) open "testfile"
+(sparse-hole) seek "testfile" to 20000
+(sparse-hole) write 512 bytes to "testfile"
+(sparse-hole) seek "testfile" to 60000
+(sparse-hole) write 100 bytes to "testfile"
+(sparse-hole) close "testfile"
+(sparse-hole) open "testfile" for verification
+(sparse-hole) verified contents of "testfile"
+(sparse-hole) close "testfile"
+(sparse-hole) end
+EOF
+pass;
@@ -0,0 +1,31 @@
+/* Passes invalid fds and an oversized length to
+   copy_file_range(), which must fail with -1. */
+
+#include <limits.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void) 
+{
+  static const int fds[] = {0x20101234, 5, 1234, 0, 1, -1, INT_MIN,
+                            INT_MAX};
+  size_t i;
+  int in, out;
+
+  CHECK (create ("test.txt", 0), "create \"test.txt\"");
+  CHECK ((in = open ("sample.txt")) > 1, "open \"sample.txt\"");
+  CHECK ((out = open ("test.txt")) > 1, "open \"test.txt\"");
+
+  for (i = 0; i < sizeof fds / sizeof *fds; i++)
+    {
+      if (copy_file_range (fds[i], out, 10) != -1)
+        fail ("copy_file_range() from fd %d did not fail", fds[i]);
+      if (copy_file_range (in, fds[i], 10) != -1)
+        fail ("copy_file_range() to fd %d did not fail", fds[i]);
+    }
+  CHECK (copy_file_range (in, out, 0x80000000) == -1,
+         "copy_file_range() of 0x80000000 bytes fails");
+  CHECK (tell (in) == 0 && filesize (out) == 0, "nothing was copied");
+}
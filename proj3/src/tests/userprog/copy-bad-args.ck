@@ -0,0 +1,15 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(copy-bad-args) begin
+(copy-bad-args) create "test.txt"
+(copy-bad-args) open "sample.txt"
+(copy-bad-args) open "test.txt"
+(copy-bad-args) copy_file_range() of 0x80000000 bytes fails
+(copy-bad-args) nothing was copied
+(copy-bad-args) end
+copy-bad-args: exit(0)
+EOF
+pass;
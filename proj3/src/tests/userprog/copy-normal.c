@@ -0,0 +1,34 @@
+/* Copies a file with two copy_file_range() calls and checks the
+   copy and both file positions. */
+
+#include <syscall.h>
+#include "tests/userprog/sample.inc"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void) 
+{
+  size_t size = sizeof sample - 1;
+  int in, out, byte_cnt;
+
+  CHECK (create ("test.txt", 0), "create \"test.txt\"");
+  CHECK ((in = open ("sample.txt")) > 1, "open \"sample.txt\"");
+  CHECK ((out = open ("test.txt")) > 1, "open \"test.txt\"");
+
+  byte_cnt = copy_file_range (in, out, 100);
+  if (byte_cnt != 100)
+    fail ("copy_file_range() returned %d instead of 100", byte_cnt);
+  byte_cnt = copy_file_range (in, out, 1000);
+  if (byte_cnt != (int) size - 100)
+    fail ("copy_file_range() returned %d instead of %zu",
+          byte_cnt, size - 100);
+  CHECK (tell (in) == size && tell (out) == size,
+         "both file positions are at end of file");
+  CHECK (copy_file_range (in, out, 10) == 0,
+         "copy_file_range() at end of file copies nothing");
+  close (in);
+  close (out);
+
+  check_file ("test.txt", sample, size);
+}
@@ -0,0 +1,18 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(copy-normal) begin
+(copy-normal) create "test.txt"
+(copy-normal) open "sample.txt"
+(copy-normal) open "test.txt"
+(copy-normal) both file positions are at end of file
+(copy-normal) copy_file_range() at end of file copies nothing
+(copy-normal) open "test.txt" for verification
+(copy-normal) verified contents of "test.txt"
+(copy-normal) close "test.txt"
+(copy-normal) end
+copy-normal: exit(0)
+EOF
+pass;
@@ -0,0 +1,31 @@
+/* Copies within a single file through two fds.  Copying a range
+   onto itself must fail with -1; copying to a range that does
+   not overlap the source must work. */
+
+#include <syscall.h>
+#include "tests/userprog/sample.inc"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void) 
+{
+  char buf[50];
+  int in, out;
+
+  CHECK ((in = open ("sample.txt")) > 1, "open \"sample.txt\"");
+  CHECK ((out = open ("sample.txt")) > 1, "open \"sample.txt\" again");
+
+  seek (out, 20);
+  CHECK (copy_file_range (in, out, 50) == -1,
+         "copy_file_range() onto an overlapping range fails");
+  CHECK (tell (in) == 0 && tell (out) == 20,
+         "file positions are unchanged");
+
+  seek (out, 100);
+  CHECK (copy_file_range (in, out, sizeof buf) == sizeof buf,
+         "copy_file_range() onto a separate range");
+  CHECK (pread (in, buf, sizeof buf, 100) == sizeof buf,
+         "pread() the copied range");
+  compare_bytes (buf, sample, sizeof buf, 100, "sample.txt");
+}
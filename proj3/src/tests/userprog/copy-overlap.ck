@@ -0,0 +1,16 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(copy-overlap) begin
+(copy-overlap) open "sample.txt"
+(copy-overlap) open "sample.txt" again
+(copy-overlap) copy_file_range() onto an overlapping range fails
+(copy-overlap) file positions are unchanged
+(copy-overlap) copy_file_range() onto a separate range
+(copy-overlap) pread() the copied range
+(copy-overlap) end
+copy-overlap: exit(0)
+EOF
+pass;
@@ -0,0 +1,35 @@
+/* Opens a file until the fd table is full, then checks that a
+   freed fd is handed out again. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+/* Must match FD_MAX in userprog/process.h.  Fds 0 and 1 are the
+   console, so a process can have FD_MAX - 2 files open. */
+#define FD_MAX 128
+
+void
+test_main (void) 
+{
+  int fds[FD_MAX];
+  int fd_cnt, i;
+
+  for (fd_cnt = 0; fd_cnt < FD_MAX; fd_cnt++)
+    if ((fds[fd_cnt] = open ("sample.txt")) == -1)
+      break;
+  CHECK (fd_cnt == FD_MAX - 2, "open \"sample.txt\" %d times", FD_MAX - 2);
+  for (i = 0; i < fd_cnt; i++)
+    if (fds[i] != i + 2)
+      fail ("open %d returned fd %d instead of %d", i, fds[i], i + 2);
+
+  close (fds[10]);
+  close (fds[20]);
+  CHECK (open ("sample.txt") == fds[10], "reopen gets lowest free fd");
+  CHECK (open ("sample.txt") == fds[20], "reopen gets next free fd");
+  CHECK (open ("sample.txt") == -1, "open with full fd table fails");
+
+  for (i = 0; i < fd_cnt; i++)
+    close (fds[i]);
+  CHECK (open ("sample.txt") == 2, "open after closing all gets fd 2");
+}
@@ -0,0 +1,15 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(open-fd-max) begin
+(open-fd-max) open "sample.txt" 126 times
+(open-fd-max) reopen gets lowest free fd
+(open-fd-max) reopen gets next free fd
+(open-fd-max) open with full fd table fails
+(open-fd-max) open after closing all gets fd 2
+(open-fd-max) end
+open-fd-max: exit(0)
+EOF
+pass;
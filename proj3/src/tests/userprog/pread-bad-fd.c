@@ -0,0 +1,19 @@
+/* Tries to pread() from invalid fds, which must fail with -1. */
+
+#include <limits.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void) 
+{
+  static const int fds[] = {0x20101234, 5, 1234, 1, -1, -1024, INT_MIN,
+                            INT_MAX};
+  char buf;
+  size_t i;
+
+  for (i = 0; i < sizeof fds / sizeof *fds; i++)
+    if (pread (fds[i], &buf, 1, 0) != -1)
+      fail ("pread() from fd %d did not fail", fds[i]);
+}
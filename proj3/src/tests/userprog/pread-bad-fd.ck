@@ -0,0 +1,10 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(pread-bad-fd) begin
+(pread-bad-fd) end
+pread-bad-fd: exit(0)
+EOF
+pass;
@@ -0,0 +1,26 @@
+/* Passes file offsets that do not fit in a signed 32-bit offset
+   to pread() and pwrite(), which must fail with -1. */
+
+#include <syscall.h>
+#include "tests/userprog/sample.inc"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void) 
+{
+  char buf[16];
+  int handle;
+
+  CHECK ((handle = open ("sample.txt")) > 1, "open \"sample.txt\"");
+
+  CHECK (pread (handle, buf, sizeof buf, 0x80000000) == -1,
+         "pread() at offset 0x80000000 fails");
+  CHECK (pread (handle, buf, sizeof buf, 0x7ffffff8) == -1,
+         "pread() that ends past offset 0x7fffffff fails");
+  CHECK (pwrite (handle, buf, sizeof buf, 0xfffffff0) == -1,
+         "pwrite() at offset 0xfffffff0 fails");
+  CHECK (pwrite (handle, buf, sizeof buf, 0x7ffffff8) == -1,
+         "pwrite() that ends past offset 0x7fffffff fails");
+  CHECK (filesize (handle) == (int) (sizeof sample - 1), "file size is unchanged");
+}
@@ -0,0 +1,16 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(pread-bad-ofs) begin
+(pread-bad-ofs) open "sample.txt"
+(pread-bad-ofs) pread() at offset 0x80000000 fails
+(pread-bad-ofs) pread() that ends past offset 0x7fffffff fails
+(pread-bad-ofs) pwrite() at offset 0xfffffff0 fails
+(pread-bad-ofs) pwrite() that ends past offset 0x7fffffff fails
+(pread-bad-ofs) file size is unchanged
+(pread-bad-ofs) end
+pread-bad-ofs: exit(0)
+EOF
+pass;
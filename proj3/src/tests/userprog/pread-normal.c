@@ -0,0 +1,34 @@
+/* Reads parts of a file with pread() and checks that the file
+   position is left alone. */
+
+#include <syscall.h>
+#include "tests/userprog/sample.inc"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void) 
+{
+  char buf[sizeof sample];
+  size_t ofs = 17, size = 40;
+  int handle, byte_cnt;
+
+  CHECK ((handle = open ("sample.txt")) > 1, "open \"sample.txt\"");
+
+  byte_cnt = pread (handle, buf, size, ofs);
+  if (byte_cnt != (int) size)
+    fail ("pread() returned %d instead of %zu", byte_cnt, size);
+  compare_bytes (buf, sample + ofs, size, ofs, "sample.txt");
+
+  byte_cnt = pread (handle, buf, sizeof buf, ofs);
+  if (byte_cnt != (int) (sizeof sample - 1 - ofs))
+    fail ("pread() returned %d instead of %zu",
+          byte_cnt, sizeof sample - 1 - ofs);
+  compare_bytes (buf, sample + ofs, byte_cnt, ofs, "sample.txt");
+
+  byte_cnt = pread (handle, buf, sizeof buf, sizeof sample + 100);
+  if (byte_cnt != 0)
+    fail ("pread() past end of file returned %d instead of 0", byte_cnt);
+
+  CHECK (tell (handle) == 0, "file position is still 0");
+}
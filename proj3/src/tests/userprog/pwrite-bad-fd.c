@@ -0,0 +1,14 @@
+/* Tries to pwrite() to an invalid fd, which must terminate the
+   process with exit code -1, as write() does. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void) 
+{
+  char buf = 123;
+  pwrite (7, &buf, 1, 0);
+  fail ("should not have survived pwrite()");
+}
@@ -0,0 +1,9 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(pwrite-bad-fd) begin
+pwrite-bad-fd: exit(-1)
+EOF
+pass;
@@ -0,0 +1,21 @@
+/* Tries to readv() from invalid fds, which must fail with -1. */
+
+#include <iovec.h>
+#include <limits.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void) 
+{
+  static const int fds[] = {0x20101234, 5, 1234, 1, -1, -1024, INT_MIN,
+                            INT_MAX};
+  char buf;
+  struct iovec iov = {&buf, 1};
+  size_t i;
+
+  for (i = 0; i < sizeof fds / sizeof *fds; i++)
+    if (readv (fds[i], &iov, 1) != -1)
+      fail ("readv() from fd %d did not fail", fds[i]);
+}
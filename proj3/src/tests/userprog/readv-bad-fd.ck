@@ -0,0 +1,10 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(readv-bad-fd) begin
+(readv-bad-fd) end
+readv-bad-fd: exit(0)
+EOF
+pass;
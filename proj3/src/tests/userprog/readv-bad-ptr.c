@@ -0,0 +1,20 @@
+/* Passes a buffer with an invalid pointer to the readv system
+   call.  The process must be terminated with -1 exit code. */
+
+#include <iovec.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void) 
+{
+  char buf[8];
+  struct iovec iov[2] = {{buf, sizeof buf}, {(char *) 0xc0100000, 123}};
+  int handle;
+
+  CHECK ((handle = open ("sample.txt")) > 1, "open \"sample.txt\"");
+
+  readv (handle, iov, 2);
+  fail ("should not have survived readv()");
+}
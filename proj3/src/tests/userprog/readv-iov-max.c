@@ -0,0 +1,33 @@
+/* Passes IOV_MAX buffers to readv(), which must succeed, then
+   more than IOV_MAX and a negative count, which must fail with
+   -1. */
+
+#include <iovec.h>
+#include <syscall.h>
+#include "tests/userprog/sample.inc"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void) 
+{
+  char buf[IOV_MAX + 1];
+  struct iovec iov[IOV_MAX + 1];
+  int handle;
+  size_t i;
+
+  for (i = 0; i < IOV_MAX + 1; i++)
+    {
+      iov[i].iov_base = buf + i;
+      iov[i].iov_len = 1;
+    }
+
+  CHECK ((handle = open ("sample.txt")) > 1, "open \"sample.txt\"");
+  CHECK (readv (handle, iov, IOV_MAX) == IOV_MAX,
+         "readv() with IOV_MAX buffers");
+  compare_bytes (buf, sample, IOV_MAX, 0, "sample.txt");
+  CHECK (readv (handle, iov, IOV_MAX + 1) == -1,
+         "readv() with IOV_MAX + 1 buffers fails");
+  CHECK (readv (handle, iov, -1) == -1, "readv() with -1 buffers fails");
+  CHECK (tell (handle) == IOV_MAX, "file position is IOV_MAX");
+}
@@ -0,0 +1,15 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(readv-iov-max) begin
+(readv-iov-max) open "sample.txt"
+(readv-iov-max) readv() with IOV_MAX buffers
+(readv-iov-max) readv() with IOV_MAX + 1 buffers fails
+(readv-iov-max) readv() with -1 buffers fails
+(readv-iov-max) file position is IOV_MAX
+(readv-iov-max) end
+readv-iov-max: exit(0)
+EOF
+pass;
@@ -0,0 +1,17 @@
+/* Tries to writev() to an invalid fd, which must terminate the
+   process with exit code -1, as write() does. */
+
+#include <iovec.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void) 
+{
+  char buf = 123;
+  struct iovec iov = {&buf, 1};
+
+  writev (7, &iov, 1);
+  fail ("should not have survived writev()");
+}
@@ -38,8 +38,10 @@
 #ifdef FILESYS
 #include "devices/block.h"
 #include "devices/ide.h"
+#include "filesys/cache.h"
 #include "filesys/filesys.h"
 #include "filesys/fsutil.h"
+#include "filesys/journal.h"
 #endif
 
 /* Page directory with kernel mappings only. */
@@ -258,6 +260,18 @@ parse_options (char **argv)
         filesys_bdev_name = value;
       else if (!strcmp (name, "-scratch"))
         scratch_bdev_name = value;
+      else if (!strcmp (name, "-flush"))
+        cache_flush_ms = atoi (value);
+      else if (!strcmp (name, "-dirty"))
+        {
+          cache_dirty_pct = atoi (value);
+          if (cache_dirty_pct > 100)
+            PANIC ("-dirty must be between 0 and 100");
+        }
+      else if (!strcmp (name, "-pio"))
+        ide_pio_only = true;
+      else if (!strcmp (name, "-crash"))
+        journal_crash = true;
 #ifdef VM
       else if (!strcmp (name, "-swap"))
         swap_bdev_name = value;
@@ -384,6 +398,10 @@ usage (void)
           "  -f                 Format file system device during startup.\n"
           "  -filesys=BDEV      Use BDEV for file system instead of default.\n"
           "  -scratch=BDEV      Use BDEV for scratch instead of default.\n"
+          "  -flush=MS          Write back dirty cache sectors every MS ms.\n"
+          "  -dirty=PCT         Make writers flush when PCT%% of cache is dirty.\n"
+          "  -pio               Use PIO instead of DMA for IDE disks.\n"
+          "  -crash             Leave last journal commit to be replayed.\n"
 #ifdef VM
           "  -swap=BDEV         Use BDEV for swap instead of default.\n"
 #endif
@@ -101,7 +101,9 @@ thread_init (void)
   initial_thread->tid = allocate_tid ();
 
   #ifdef USERPROG
-    list_init (&initial_thread->fd_list);
+    initial_thread->fds = NULL;
+    initial_thread->fd_cnt = 0;
+    initial_thread->fd_free = FILENO_START;
     sema_init (&initial_thread->loaded, 0);
     sema_init (&initial_thread->finished, 0);
     sema_init (&initial_thread->can_destroy, 1);
@@ -211,7 +213,9 @@ thread_create (const char *name, int priority,
   sf->ebp = 0;
 
   #ifdef USERPROG
-    list_init (&t->fd_list);
+    t->fds = NULL;
+    t->fd_cnt = 0;
+    t->fd_free = FILENO_START;
     sema_init (&t->loaded, 0);
     sema_init (&t->finished, 0);
     sema_init (&t->can_destroy, 0);
@@ -102,7 +102,9 @@ struct thread
     /* Owned by userprog/process.c. */
     uint32_t *pagedir;                  /* Page directory. */
     struct file *exec_file;             /* Executable file. */
-    struct list fd_list;                /* File descriptor list. */
+    struct file **fds;                  /* Open files, indexed by fd. */
+    int fd_cnt;                         /* Number of slots in FDS. */
+    int fd_free;                        /* No free fd is lower than this. */
     struct list child_list;             /* List of child process threads. */
     struct list_elem child_elem;        /* List element for child process threads list. */
     struct semaphore loaded;            /* Sema up when thread is finished loading. */
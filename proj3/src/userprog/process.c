@@ -127,14 +127,12 @@ process_exit (void)
   struct thread *cur = thread_current ();
   uint32_t *pd;
 
-  /* Close files and free file descriptors. */
-  while (!list_empty (&cur->fd_list))
-  {
-    struct list_elem *e = list_pop_front (&cur->fd_list);
-    struct file_descriptor *fildes = list_entry (e, struct file_descriptor, elem);
-    file_close (fildes->file);
-    free (fildes);
-  }
+  /* Close files and free the file descriptor table. */
+  for (int fd = 0; fd < cur->fd_cnt; fd++)
+    file_close (cur->fds[fd]);
+  free (cur->fds);
+  cur->fds = NULL;
+  cur->fd_cnt = 0;
 
   /* Allow all children to die. */
   while (!list_empty (&cur->child_list))
@@ -285,9 +283,7 @@ load (const char *file_name, void (**eip) (void), void **esp)
   process_activate ();
 
   /* Open executable file. */
-  lock_acquire (&fs_lock);
   file = filesys_open (t->name);
-  lock_release (&fs_lock);
   
   if (file == NULL) 
     {
@@ -4,19 +4,19 @@
 #include "filesys/off_t.h"
 #include "threads/thread.h"
 
+/* File descriptors.  0 and 1 are the console; files opened by a
+   process get the lowest free fd from FILENO_START up, in a table
+   that starts with FD_TABLE_MIN slots and doubles as needed.  No
+   fd is FD_MAX or above, which limits how many files a process
+   may have open. */
 #define FILENO_START 2
+#define FD_TABLE_MIN 16
+#define FD_MAX 128
 
 /* Map region identifier. */
 typedef int mapid_t;
 #define MAP_FAILED ((mapid_t) -1)
 
-struct file_descriptor
-{
-  int fileno;
-  struct file *file;
-  struct list_elem elem;
-};
-
 struct mmap_fd
 {
   mapid_t mapid;
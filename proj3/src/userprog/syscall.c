@@ -1,15 +1,20 @@
 #include "userprog/syscall.h"
 #include "userprog/pagedir.h"
 #include "userprog/process.h"
+#include <dirent.h>
+#include <iovec.h>
 #include <stdio.h>
+#include <string.h>
 #include <syscall-nr.h>
 #include "devices/shutdown.h"
 #include "threads/interrupt.h"
 #include "threads/thread.h"
 #include "threads/vaddr.h"
 #include "threads/malloc.h"
+#include "filesys/directory.h"
 #include "filesys/filesys.h"
 #include "filesys/file.h"
+#include "filesys/inode.h"
 #include "vm/frame.h"
 #include "vm/page.h"
 
@@ -23,12 +28,23 @@ static int open (const char *file);
 static int filesize (int fd); 
 static int read (int fd, void *buffer, unsigned size);
 static int write (int fd, void *buffer, unsigned size);
+static int pread (int fd, void *buffer, unsigned size, unsigned position);
+static int pwrite (int fd, void *buffer, unsigned size, unsigned position);
+static int readv (int fd, const struct iovec *iov, int iovcnt);
+static int writev (int fd, const struct iovec *iov, int iovcnt);
+static int copy_file_range (int fd_in, int fd_out, unsigned size);
+static int getdents (int fd, struct dirent *ents, unsigned cnt, unsigned flags);
 static void seek (int fd, unsigned position);
 static void close (int fd);
 static mapid_t mmap (int fd, void *addr);
 static void munmap (mapid_t mapid);
 static void kill_on_bad_uaddr (void *uaddr);
-static struct file_descriptor *get_fildes (int fileno);
+static bool valid_range (unsigned size, unsigned position);
+static bool copy_in_iovecs (struct iovec *, const struct iovec *uiov, int iovcnt);
+static void pin_iovecs (struct iovec *, int iovcnt);
+static void unpin_iovecs (struct iovec *, int iovcnt);
+static int add_file (struct file *file);
+static struct file *get_file (int fd);
 
 void
 syscall_init (void) 
@@ -39,7 +55,6 @@ syscall_init (void)
 static void
 syscall_handler (struct intr_frame *f UNUSED) 
 {
-  ASSERT (!lock_held_by_current_thread (&fs_lock));
   unsigned *sp = (unsigned *)f->esp;
   
   kill_on_bad_uaddr (sp);
@@ -48,6 +63,7 @@ syscall_handler (struct intr_frame *f UNUSED)
   unsigned arg0 = (unsigned)*(sp + 1);
   unsigned arg1 = (unsigned)*(sp + 2);
   unsigned arg2 = (unsigned)*(sp + 3);
+  unsigned arg3 = (unsigned)*(sp + 4);
 
   switch (sys_code)
   {
@@ -65,6 +81,12 @@ syscall_handler (struct intr_frame *f UNUSED)
     case SYS_CLOSE:     kill_on_bad_uaddr (sp + 1); close (arg0); break;
     case SYS_MMAP:      kill_on_bad_uaddr (sp + 2); f->eax = mmap (arg0, (void *)arg1); break;
     case SYS_MUNMAP:    kill_on_bad_uaddr (sp + 1); munmap (arg0); break;
+    case SYS_PREAD:     kill_on_bad_uaddr (sp + 4); f->eax = pread (arg0, (void *)arg1, arg2, arg3); break;
+    case SYS_PWRITE:    kill_on_bad_uaddr (sp + 4); f->eax = pwrite (arg0, (void *)arg1, arg2, arg3); break;
+    case SYS_READV:     kill_on_bad_uaddr (sp + 3); f->eax = readv (arg0, (struct iovec *)arg1, arg2); break;
+    case SYS_WRITEV:    kill_on_bad_uaddr (sp + 3); f->eax = writev (arg0, (struct iovec *)arg1, arg2); break;
+    case SYS_COPY_FILE_RANGE: kill_on_bad_uaddr (sp + 3); f->eax = copy_file_range (arg0, arg1, arg2); break;
+    case SYS_GETDENTS:  kill_on_bad_uaddr (sp + 4); f->eax = getdents (arg0, (struct dirent *)arg1, arg2, arg3); break;
     default:            printf("syscall.c: Unknown syscall code.\n"); thread_exit (); break;
   }
 }
@@ -124,9 +146,7 @@ create (const char *file, unsigned initial_size)
   kill_on_bad_uaddr ((void *) file);
 
   frame_pin_string (file);
-  lock_acquire (&fs_lock);
   bool success = filesys_create (file, initial_size);
-  lock_release (&fs_lock);
   frame_unpin_string (file);
 
   return success;
@@ -138,9 +158,7 @@ remove (const char *file)
   kill_on_bad_uaddr ((void *) file);
 
   frame_pin_string (file);
-  lock_acquire (&fs_lock);
   bool success = filesys_remove (file);
-  lock_release (&fs_lock);
   frame_unpin_string (file);
 
   return success;
@@ -152,35 +170,26 @@ open (const char *file)
   kill_on_bad_uaddr ((void *) file);
 
   frame_pin_string (file);
-  lock_acquire (&fs_lock);
   struct file *f = filesys_open ((void *)file);
-  lock_release (&fs_lock);
   frame_unpin_string (file);
 
   if (!f)
     return ERROR;
 
-  struct list *fd_list = &thread_current ()->fd_list;
-  struct file_descriptor *fd = malloc (sizeof (struct file_descriptor));
-  fd->file = f;
-  if (list_empty (fd_list))
-    fd->fileno = FILENO_START;
-  else
-    fd->fileno = list_entry (list_back (fd_list), struct file_descriptor, elem)->fileno + 1;
-  list_push_back (fd_list, &fd->elem);
-  return fd->fileno;
+  int fd = add_file (f);
+  if (fd == ERROR)
+    file_close (f);
+  return fd;
 }
 
 static int
 filesize (int fd)
 {
-  struct file_descriptor *fildes = get_fildes(fd);
-  if (!fildes)
+  struct file *file = get_file (fd);
+  if (!file)
     return ERROR;
 
-  lock_acquire (&fs_lock);
-  int len = file_length (fildes->file);
-  lock_release (&fs_lock);
+  int len = file_length (file);
   return len;
 }
 
@@ -189,8 +198,8 @@ read (int fd, void *buffer, unsigned size)
 {
   kill_on_bad_uaddr ((void *) buffer);
 
-  struct file_descriptor *fildes = get_fildes(fd);
-  if (!fildes)
+  struct file *file = get_file (fd);
+  if (!file)
     return ERROR;
 
   /* Disallow writing to the code segment. */
@@ -199,9 +208,7 @@ read (int fd, void *buffer, unsigned size)
     syscall_exit (ERROR);
 
   frame_pin_buffer (buffer, size);
-  lock_acquire (&fs_lock);
-  int read = file_read (fildes->file, buffer, size);
-  lock_release (&fs_lock);
+  int read = file_read (file, buffer, size);
   frame_unpin_buffer (buffer, size);
 
   return read;
@@ -220,59 +227,200 @@ write (int fd, void *buffer, unsigned size)
     return size;
   }
 
-  struct file_descriptor *fildes = get_fildes(fd);
-  if (!fildes)
+  struct file *file = get_file (fd);
+  if (!file)
+    syscall_exit (ERROR);
+
+  frame_pin_buffer (buffer, size);
+  int write = file_write (file, buffer, size);
+  frame_unpin_buffer (buffer, size);
+
+  return write;
+}
+
+static int
+pread (int fd, void *buffer, unsigned size, unsigned position)
+{
+  kill_on_bad_uaddr ((void *) buffer);
+
+  struct file *file = get_file (fd);
+  if (!file || !valid_range (size, position))
+    return ERROR;
+
+  /* Disallow writing to the code segment. */
+  struct spte *spte = page_get_spte (buffer);
+  if (spte && spte->page_type == FILE && !spte->file_page.writable)
+    syscall_exit (ERROR);
+
+  frame_pin_buffer (buffer, size);
+  int read = file_read_at (file, buffer, size, position);
+  frame_unpin_buffer (buffer, size);
+
+  return read;
+}
+
+static int
+pwrite (int fd, void *buffer, unsigned size, unsigned position)
+{
+  kill_on_bad_uaddr ((void *) buffer);
+
+  struct file *file = get_file (fd);
+  if (!file)
     syscall_exit (ERROR);
+  if (!valid_range (size, position))
+    return ERROR;
 
   frame_pin_buffer (buffer, size);
-  lock_acquire (&fs_lock);
-  int write = file_write (fildes->file, buffer, size);
-  lock_release (&fs_lock);
+  int write = file_write_at (file, buffer, size, position);
   frame_unpin_buffer (buffer, size);
 
   return write;
 }
 
+static int
+readv (int fd, const struct iovec *uiov, int iovcnt)
+{
+  struct iovec iov[IOV_MAX];
+  if (!copy_in_iovecs (iov, uiov, iovcnt))
+    return ERROR;
+
+  struct file *file = get_file (fd);
+  if (!file)
+    return ERROR;
+
+  /* Disallow writing to the code segment. */
+  for (int i = 0; i < iovcnt; i++)
+  {
+    struct spte *spte = page_get_spte (iov[i].iov_base);
+    if (iov[i].iov_len && spte && spte->page_type == FILE && !spte->file_page.writable)
+      syscall_exit (ERROR);
+  }
+
+  pin_iovecs (iov, iovcnt);
+  int read = file_readv (file, iov, iovcnt);
+  unpin_iovecs (iov, iovcnt);
+
+  return read;
+}
+
+static int
+writev (int fd, const struct iovec *uiov, int iovcnt)
+{
+  struct iovec iov[IOV_MAX];
+  if (!copy_in_iovecs (iov, uiov, iovcnt))
+    return ERROR;
+
+  if (fd == STDOUT_FILENO)
+  {
+    int written = 0;
+    pin_iovecs (iov, iovcnt);
+    for (int i = 0; i < iovcnt; i++)
+    {
+      putbuf (iov[i].iov_base, iov[i].iov_len);
+      written += iov[i].iov_len;
+    }
+    unpin_iovecs (iov, iovcnt);
+    return written;
+  }
+
+  struct file *file = get_file (fd);
+  if (!file)
+    syscall_exit (ERROR);
+
+  pin_iovecs (iov, iovcnt);
+  int write = file_writev (file, iov, iovcnt);
+  unpin_iovecs (iov, iovcnt);
+
+  return write;
+}
+
+static int
+copy_file_range (int fd_in, int fd_out, unsigned size)
+{
+  struct file *in = get_file (fd_in);
+  struct file *out = get_file (fd_out);
+  if (!in || !out || size > INT32_MAX)
+    return ERROR;
+
+  /* Copying a range of a file onto itself is not allowed. */
+  if (file_get_inode (in) == file_get_inode (out))
+  {
+    unsigned in_pos = file_tell (in);
+    unsigned out_pos = file_tell (out);
+    if (in_pos < out_pos + size && out_pos < in_pos + size)
+      return ERROR;
+  }
+
+  return file_copy (out, in, size);
+}
+
+static int
+getdents (int fd, struct dirent *ents, unsigned cnt, unsigned flags)
+{
+  kill_on_bad_uaddr ((void *) ents);
+
+  struct file *file = get_file (fd);
+  if (!file || !inode_is_dir (file_get_inode (file))
+      || cnt > INT32_MAX / sizeof *ents)
+    return ERROR;
+
+  /* Disallow writing to the code segment. */
+  struct spte *spte = page_get_spte (ents);
+  if (spte && spte->page_type == FILE && !spte->file_page.writable)
+    syscall_exit (ERROR);
+
+  /* The directory's position is kept as the file's position. */
+  struct dir *dir = dir_open (inode_reopen (file_get_inode (file)));
+  if (!dir)
+    return ERROR;
+  dir_seek (dir, file_tell (file));
+
+  unsigned size = cnt * sizeof *ents;
+  frame_pin_buffer (ents, size);
+  int read = dir_readdir_batch (dir, ents, cnt, flags & GETDENTS_STAT);
+  frame_unpin_buffer (ents, size);
+
+  file_seek (file, dir_tell (dir));
+  dir_close (dir);
+  return read;
+}
+
 static void
 seek (int fd, unsigned position)
 {
-  struct file_descriptor *fildes = get_fildes(fd);
-  if (fildes)
+  struct file *file = get_file (fd);
+  if (file)
   {
-    lock_acquire (&fs_lock);
-    file_seek (fildes->file, position);
-    lock_release (&fs_lock);
+    file_seek (file, position);
   }
 }
 
 static void
 close (int fd)
 {
-  struct file_descriptor *fildes = get_fildes(fd);
-  if (fildes)
+  struct file *file = get_file (fd);
+  if (file)
   {
-    lock_acquire (&fs_lock);
-    file_close (fildes->file);
-    lock_release (&fs_lock);
-    list_remove (&fildes->elem);
-    free (fildes);
+    struct thread *t = thread_current ();
+    file_close (file);
+    t->fds[fd] = NULL;
+    if (fd < t->fd_free)
+      t->fd_free = fd;
   }
 }
 
 static mapid_t
 mmap (int fd, void *addr)
 {
-  struct file_descriptor *fildes = get_fildes(fd);
+  struct file *file = get_file (fd);
 
-  if (!fildes || pg_ofs (addr) || !addr || !file_length (fildes->file))
+  if (!file || pg_ofs (addr) || !addr || !file_length (file))
     return MAP_FAILED;
   
-  lock_acquire (&fs_lock);
-  struct file *file = file_reopen (fildes->file);
-  int len = file_length (file);
-  lock_release (&fs_lock);
+  struct file *map_file = file_reopen (file);
+  int len = file_length (map_file);
 
-  return page_add_mmap_lazily (addr, file, len);
+  return page_add_mmap_lazily (addr, map_file, len);
 }
 
 static void
@@ -288,16 +436,88 @@ kill_on_bad_uaddr (void *uaddr)
     syscall_exit (ERROR);
 }
 
-static struct file_descriptor *
-get_fildes (int fileno)
+static bool
+valid_range (unsigned size, unsigned position)
+{
+  return position <= INT32_MAX && size <= INT32_MAX - position;
+}
+
+static bool
+copy_in_iovecs (struct iovec *iov, const struct iovec *uiov, int iovcnt)
+{
+  if (iovcnt < 0 || iovcnt > IOV_MAX)
+    return false;
+  if (iovcnt == 0)
+    return true;
+
+  kill_on_bad_uaddr ((void *) uiov);
+  kill_on_bad_uaddr ((void *) (uiov + iovcnt) - 1);
+  memcpy (iov, uiov, iovcnt * sizeof *iov);
+
+  size_t total = 0;
+  for (int i = 0; i < iovcnt; i++)
+  {
+    if (iov[i].iov_len > INT32_MAX - total)
+      return false;
+    total += iov[i].iov_len;
+    if (iov[i].iov_len)
+      kill_on_bad_uaddr (iov[i].iov_base);
+  }
+  return true;
+}
+
+static void
+pin_iovecs (struct iovec *iov, int iovcnt)
+{
+  for (int i = 0; i < iovcnt; i++)
+    if (iov[i].iov_len)
+      frame_pin_buffer (iov[i].iov_base, iov[i].iov_len);
+}
+
+static void
+unpin_iovecs (struct iovec *iov, int iovcnt)
+{
+  for (int i = 0; i < iovcnt; i++)
+    if (iov[i].iov_len)
+      frame_unpin_buffer (iov[i].iov_base, iov[i].iov_len);
+}
+
+static int
+add_file (struct file *file)
 {
-  struct list *fd_list = &thread_current ()->fd_list;
-  for (struct list_elem *e = list_begin (fd_list);
-       e != list_end (fd_list); e = list_next (e))
+  struct thread *t = thread_current ();
+
+  /* Hand out the lowest free fd, growing the table if it is full. */
+  int fd = t->fd_free;
+  while (fd < t->fd_cnt && t->fds[fd])
+    fd++;
+  if (fd >= t->fd_cnt)
   {
-    struct file_descriptor *fildes = list_entry (e, struct file_descriptor, elem);
-    if (fildes->fileno == fileno)
-      return fildes;
+    if (fd >= FD_MAX)
+      return ERROR;
+    int cnt = t->fd_cnt ? t->fd_cnt : FD_TABLE_MIN;
+    while (cnt <= fd)
+      cnt *= 2;
+    if (cnt > FD_MAX)
+      cnt = FD_MAX;
+    struct file **fds = realloc (t->fds, cnt * sizeof *fds);
+    if (!fds)
+      return ERROR;
+    memset (fds + t->fd_cnt, 0, (cnt - t->fd_cnt) * sizeof *fds);
+    t->fds = fds;
+    t->fd_cnt = cnt;
   }
-  return NULL;
+
+  t->fds[fd] = file;
+  t->fd_free = fd + 1;
+  return fd;
+}
+
+static struct file *
+get_file (int fd)
+{
+  struct thread *t = thread_current ();
+  if (fd < FILENO_START || fd >= t->fd_cnt)
+    return NULL;
+  return t->fds[fd];
 }
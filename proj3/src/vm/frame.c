@@ -104,15 +104,21 @@ evict ()
     list_push_back (&frame_table, &fte->elem);
   }
 
-  /* Swap out to swap partition. */
-  spte->swap_index = swap_out (fte->kpage);
-
-  /* Invalidate page and free frame. */
+  /* Reserve a swap slot and invalidate page. */
+  size_t swap_index = swap_reserve ();
+  spte->swap_index = swap_index;
   pagedir_clear_page (fte->owner->pagedir, upage);
   spte->fte = NULL;
-  palloc_free_page (fte->kpage);
   lock_release (&ft_lock);
 
+  /* Swap out to swap partition without holding the frame table
+   * lock, so that other threads can fault in pages meanwhile,
+   * keeping the file system disk busy while the swap disk is.
+   * The frame is off the table and unmapped, so nobody else
+   * touches it. */
+  swap_write (fte->kpage, swap_index);
+  palloc_free_page (fte->kpage);
+
   /* Deallocate frame table entry. */
   free (fte);
 }
@@ -146,8 +152,6 @@ frame_free (struct fte *fte)
 static void
 write_back (struct spte *spte)
 {
-  ASSERT (!lock_held_by_current_thread (&fs_lock));
-
   struct file *file;
   off_t offset;
 
@@ -160,9 +164,7 @@ write_back (struct spte *spte)
     default:    return;
   }
 
-  lock_acquire (&fs_lock);
   file_write_at (file, spte->fte->kpage, PGSIZE, offset);
-  lock_release (&fs_lock);
 }
 
 void
@@ -146,8 +146,6 @@ load_zero_page (struct spte *spte)
 static void
 load_file_page (struct spte *spte)
 {
-  ASSERT (!lock_held_by_current_thread (&fs_lock));
-
   void *kpage = frame_alloc (spte, PAL_USER, spte->file_page.writable)->kpage;
 
   struct file *file = spte->file_page.file;
@@ -156,9 +154,7 @@ load_file_page (struct spte *spte)
   off_t zero_bytes = PGSIZE - read_bytes;
 
   /* Load the file to page. */
-  lock_acquire (&fs_lock);
   ASSERT (file_read_at (file, kpage, read_bytes, offset) == read_bytes);
-  lock_release (&fs_lock);
   memset (kpage + read_bytes, 0, zero_bytes);
 }
 
@@ -176,8 +172,6 @@ load_swap_page (struct spte *spte)
 static void
 load_mmap_page (struct spte *spte)
 {
-  ASSERT (!lock_held_by_current_thread (&fs_lock));
-
   void *kpage = frame_alloc (spte, PAL_USER, true)->kpage;
 
   struct file *file = spte->mmap_page.mmap_fd->file;
@@ -186,9 +180,7 @@ load_mmap_page (struct spte *spte)
   off_t zero_bytes = PGSIZE - read_bytes;
 
   /* Load the file to page. */
-  lock_acquire (&fs_lock);
   ASSERT (file_read_at (file, kpage, read_bytes, offset) == read_bytes);
-  lock_release (&fs_lock);
   memset (kpage + read_bytes, 0, zero_bytes);
 }
 
@@ -9,6 +9,14 @@
 static struct block *swap_block;
 static struct bitmap *swap_table;
 
+/* Slots reserved by swap_reserve() whose swap_write() has not
+   finished.  Both bitmaps are protected by SWAP_LOCK. */
+static struct bitmap *writing_table;
+static struct lock swap_lock;
+static struct condition write_done;
+
+static void wait_for_write (size_t);
+
 void
 swap_init (void)
 {
@@ -16,42 +24,77 @@ swap_init (void)
 
   swap_block = block_get_role (BLOCK_SWAP);
   swap_table = bitmap_create (block_size (swap_block) / FRAME_SECTORS);
+  writing_table = bitmap_create (bitmap_size (swap_table));
+  lock_init (&swap_lock);
+  cond_init (&write_done);
 }
 
+/* Reserves a slot to be filled by swap_write().  Until the write
+   finishes, swap_in() and swap_free_index() on the slot wait for
+   it, so the caller need not hold any lock during the write. */
 size_t
-swap_out (uint8_t *kpage)
+swap_reserve (void)
 {
+  lock_acquire (&swap_lock);
   size_t swap_index = bitmap_scan_and_flip (swap_table, 0, 1, SWAP_FREE);
 
   ASSERT (swap_index != (uint16_t) BITMAP_ERROR);
 
-  block_sector_t sector = swap_index * FRAME_SECTORS;
-
-  for (int offset = 0; offset < PGSIZE; offset += BLOCK_SECTOR_SIZE, sector++)
-    block_write (swap_block, sector, kpage + offset);
+  bitmap_mark (writing_table, swap_index);
+  lock_release (&swap_lock);
 
   return swap_index;
 }
 
+void
+swap_write (uint8_t *kpage, size_t swap_index)
+{
+  block_write_multiple (swap_block, swap_index * FRAME_SECTORS, kpage,
+                        FRAME_SECTORS);
+
+  lock_acquire (&swap_lock);
+  bitmap_reset (writing_table, swap_index);
+  cond_broadcast (&write_done, &swap_lock);
+  lock_release (&swap_lock);
+}
+
 void
 swap_in (uint8_t *kpage, size_t swap_index)
 {
-  block_sector_t sector = swap_index * FRAME_SECTORS;
+  lock_acquire (&swap_lock);
+  wait_for_write (swap_index);
+  lock_release (&swap_lock);
 
-  for (int offset = 0; offset < PGSIZE; offset += BLOCK_SECTOR_SIZE, sector++)
-    block_read (swap_block, sector, kpage + offset);
+  block_read_multiple (swap_block, swap_index * FRAME_SECTORS, kpage,
+                       FRAME_SECTORS);
 
-  bitmap_reset (swap_table, swap_index);
+  swap_free_index (swap_index);
 }
 
 void
 swap_free_index (size_t swap_index)
 {
+  lock_acquire (&swap_lock);
+  wait_for_write (swap_index);
   bitmap_reset (swap_table, swap_index);
+  lock_release (&swap_lock);
 }
 
 bool
 swap_test_index (size_t swap_index)
 {
-  return bitmap_test (swap_table, swap_index);
+  lock_acquire (&swap_lock);
+  bool in_use = bitmap_test (swap_table, swap_index);
+  lock_release (&swap_lock);
+
+  return in_use;
+}
+
+static void
+wait_for_write (size_t swap_index)
+{
+  ASSERT (lock_held_by_current_thread (&swap_lock));
+
+  while (bitmap_test (writing_table, swap_index))
+    cond_wait (&write_done, &swap_lock);
 }